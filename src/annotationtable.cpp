@@ -0,0 +1,101 @@
+#include "annotationtable.h"
+#include "projectdatabase.h"
+#include <algorithm>
+
+AnnotationTable::AnnotationTable()
+{
+}
+
+void AnnotationTable::clear()
+{
+    addresses_.clear();
+    texts_.clear();
+}
+
+void AnnotationTable::set(uint64_t address, const QString &text)
+{
+    auto it = std::lower_bound(addresses_.begin(), addresses_.end(), address);
+    size_t index = it - addresses_.begin();
+    bool exists = it != addresses_.end() && *it == address;
+
+    if (text.isEmpty())
+    {
+        if (exists)
+        {
+            addresses_.erase(it);
+            texts_.erase(texts_.begin() + index);
+        }
+        return;
+    }
+
+    if (exists)
+    {
+        texts_[index] = text;
+        return;
+    }
+    addresses_.insert(it, address);
+    texts_.insert(texts_.begin() + index, text);
+}
+
+size_t AnnotationTable::find(uint64_t address) const
+{
+    auto it = std::lower_bound(addresses_.begin(), addresses_.end(), address);
+    if (it == addresses_.end() || *it != address)
+    {
+        return npos;
+    }
+    return it - addresses_.begin();
+}
+
+void AnnotationTable::save(ProjectDatabaseWriter &writer) const
+{
+    // The texts are stored back to back in one UTF-8 pool
+    std::vector<uint32_t> offsets;
+    std::vector<char> text;
+    offsets.reserve(texts_.size() + 1);
+    for (const QString &comment : texts_)
+    {
+        offsets.push_back(static_cast<uint32_t>(text.size()));
+        QByteArray utf8 = comment.toUtf8();
+        text.insert(text.end(), utf8.constData(),
+                    utf8.constData() + utf8.size());
+    }
+    offsets.push_back(static_cast<uint32_t>(text.size()));
+
+    writer.addCopy(ProjectDatabase::TABLE_ANNOTATION_ADDRESSES, addresses_);
+    writer.addCopy(ProjectDatabase::TABLE_ANNOTATION_TEXT_OFFSETS, offsets);
+    writer.addCopy(ProjectDatabase::TABLE_ANNOTATION_TEXT, text);
+}
+
+bool AnnotationTable::load(const ProjectDatabase &database)
+{
+    clear();
+
+    ProjectDatabase::Table<uint64_t> addresses =
+        database.table<uint64_t>(ProjectDatabase::TABLE_ANNOTATION_ADDRESSES);
+    ProjectDatabase::Table<uint32_t> offsets = database.table<uint32_t>(
+        ProjectDatabase::TABLE_ANNOTATION_TEXT_OFFSETS);
+    ProjectDatabase::Table<char> text =
+        database.table<char>(ProjectDatabase::TABLE_ANNOTATION_TEXT);
+    if (addresses.size == 0)
+    {
+        return true;
+    }
+
+    if (offsets.size != addresses.size + 1 ||
+        offsets[addresses.size] != text.size ||
+        !std::is_sorted(offsets.begin(), offsets.end()) ||
+        !std::is_sorted(addresses.begin(), addresses.end()))
+    {
+        return false;
+    }
+
+    addresses_.assign(addresses.begin(), addresses.end());
+    texts_.reserve(addresses.size);
+    for (size_t i = 0; i < addresses.size; ++i)
+    {
+        texts_.push_back(QString::fromUtf8(
+            text.data + offsets[i], static_cast<int>(offsets[i + 1] - offsets[i])));
+    }
+    return true;
+}
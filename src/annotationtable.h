@@ -0,0 +1,60 @@
+#ifndef ANNOTATIONTABLE_H
+#define ANNOTATIONTABLE_H
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ProjectDatabase;
+class ProjectDatabaseWriter;
+
+/* Comments the user attached to addresses, sorted by address. They are
+ * the only part of a project that cannot be recomputed from the binary */
+class AnnotationTable
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    AnnotationTable();
+
+    void clear();
+
+    /* Sets the comment at address. An empty text removes it */
+    void set(uint64_t address, const QString &text);
+
+    // Returns the index of the comment at address, or npos
+    size_t find(uint64_t address) const;
+
+    inline size_t size() const
+    {
+        return addresses_.size();
+    }
+
+    inline uint64_t address(size_t index) const
+    {
+        return addresses_[index];
+    }
+
+    inline const QString &text(size_t index) const
+    {
+        return texts_[index];
+    }
+
+    // Adds a copy of the comments to a database
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the comments with the ones in database. A database without
+     * comments leaves the table empty. Returns false if they are
+     * inconsistent */
+    bool load(const ProjectDatabase &database);
+
+private:
+    std::vector<uint64_t> addresses_;
+    std::vector<QString> texts_;
+};
+
+typedef std::shared_ptr<AnnotationTable> AnnotationTablePtr;
+
+#endif // ANNOTATIONTABLE_H
@@ -1,6 +1,9 @@
 #ifndef ARCHITECTURE_H
 #define ARCHITECTURE_H
+#include "disasm/decodedinstruction.h"
 #include "disasm/instructioninfo.h"
+#include "symbolresolver.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,7 +29,11 @@ public:
         
         ValueType valueType;
         Type type;
-        std::string text;
+        
+        // The range of the token's text in the TokenList text
+        uint16_t offset;
+        uint16_t length;
+        
         union {
             uint64_t address;
             uint16_t reg;
@@ -35,22 +42,116 @@ public:
 
     };
     
+    /* The formatted text of an instruction split into tokens. The text
+     * lives in an inline buffer and tokens refer to ranges of it, so a
+     * TokenList can be reused for every instruction without allocating */
+    class TokenList
+    {
+    public:
+        static const size_t MAX_TEXT = 256;
+        static const size_t MAX_TOKENS = 32;
+        
+        TokenList() : count_(0)
+        {
+            text_[0] = '\0';
+        }
+        
+        inline void clear()
+        {
+            count_ = 0;
+            text_[0] = '\0';
+        }
+        
+        inline size_t size() const
+        {
+            return count_;
+        }
+        
+        inline const Token &operator[](size_t index) const
+        {
+            return tokens_[index];
+        }
+        
+        // Returns the whole line as a null-terminated string
+        inline const char *text() const
+        {
+            return text_;
+        }
+        
+        // Returns the text of a token. It is not null-terminated
+        inline const char *text(const Token &token) const
+        {
+            return text_ + token.offset;
+        }
+        
+        // Returns the text buffer of MAX_TEXT bytes for architectures to
+        // format into
+        inline char *buffer()
+        {
+            return text_;
+        }
+        
+        // Adds a token. Returns false if the list is full
+        inline bool append(const Token &token)
+        {
+            if (count_ == MAX_TOKENS)
+            {
+                return false;
+            }
+            tokens_[count_++] = token;
+            return true;
+        }
+        
+    private:
+        char text_[MAX_TEXT];
+        Token tokens_[MAX_TOKENS];
+        size_t count_;
+    };
+    
     
     Architecture();
     
     /* Gets the text to be displayed in the disassembly view for an instruction.
-     * Returns true when the instruction was disassembled and tokens is populated */
-    virtual bool instructionText(uint64_t instructionPointer, const char *data, size_t size, std::vector<Token> &tokens) =0;
+     * Returns true when the instruction was disassembled and tokens is populated.
+     * tokens is cleared first and covers the whole text in order */
+    virtual bool instructionText(uint64_t instructionPointer, const char *data, size_t size, TokenList &tokens) =0;
     
     /* Gets information such as branching data and length from an instruction.
      * Returns true when the instruction was disassembled and iinfo is populated */
     virtual bool instructionInfo(uint64_t instructionPointer, const char *data, size_t size, InstructionInfo &iinfo) =0;
     
     
+    /* Decodes up to count consecutive instructions starting at data into
+     * records, decoding each instruction once. Stops early at the end of
+     * data or at bytes that cannot be decoded. When text is not null, the
+     * formatted text of record i is written to text + i * textStride as a
+     * null-terminated string. Returns the number of records filled */
+    virtual std::size_t decodeBatch(uint64_t instructionPointer, const char *data, std::size_t size, DecodedInstruction *records, std::size_t count, char *text = nullptr, std::size_t textStride = 0) =0;
+    
     /* Gets the register name from a register id. Returns true
      * if the register exists and the name was set */
     virtual bool registerName(uint16_t id, std::string &name) =0;
     
+    /* Creates an independent copy of the architecture. Decoding state
+     * is not shared, so each thread should use its own copy */
+    virtual std::shared_ptr<Architecture> clone() const =0;
+    
+    /* Sets the resolver used to name addresses in instruction text.
+     * Copies made with clone() share it */
+    inline void setSymbolResolver(SymbolResolverPtr symbols)
+    {
+        symbols_ = symbols;
+    }
+    
+    inline SymbolResolverPtr symbolResolver() const
+    {
+        return symbols_;
+    }
+    
+protected:
+    SymbolResolverPtr symbols_;
 };
 
+typedef std::shared_ptr<Architecture> ArchitecturePtr;
+
 #endif // ARCHITECTURE_H
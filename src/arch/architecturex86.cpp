@@ -1,6 +1,8 @@
 #include "architecturex86.h"
 #include "log.h"
 #include <QString>
+#include <cstdio>
+#include <cstring>
 
 Architecturex86::Architecturex86(Architecturex86::Mode mode)
 {
@@ -25,50 +27,58 @@ Architecturex86::Architecturex86(Architecturex86::Mode mode)
 
     ZydisFormatterInit(&formatter_, ZYDIS_FORMATTER_STYLE_INTEL);
     
-    /*
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_REG, (const void**)&Architecturex86::hookFormatOperandReg);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_MEM, (const void**)&Architecturex86::hookFormatOperandMem);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_PTR, (const void**)&Architecturex86::hookFormatOperandPtr);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_IMM, (const void**)&Architecturex86::hookFormatOperandImm);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_PRINT_OPERANDSIZE, (const void**)&Architecturex86::hookFormatPrintOperandSize);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_PRINT_SEGMENT, (const void**)&Architecturex86::hookFormatPrintSegment);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_PRINT_DECORATOR, (const void**)&Architecturex86::hookFormatPrintDecorator);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_PRINT_DISPLACEMENT, (const void**)&Architecturex86::hookFormatPrintDisplacement);
-    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_PRINT_IMMEDIATE, (const void**)&Architecturex86::hookFormatPrintImmediate);
-    */
+    // SetHook swaps the callback with the previous one, so each hook is
+    // passed through a temporary
+    const void *hook;
+    hook = reinterpret_cast<const void*>(&Architecturex86::hookFormatOperandReg);
+    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_REG, &hook);
+    hook = reinterpret_cast<const void*>(&Architecturex86::hookFormatOperandMem);
+    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_MEM, &hook);
+    hook = reinterpret_cast<const void*>(&Architecturex86::hookFormatOperandPtr);
+    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_PTR, &hook);
+    hook = reinterpret_cast<const void*>(&Architecturex86::hookFormatOperandImm);
+    ZydisFormatterSetHook(&formatter_, ZYDIS_FORMATTER_HOOK_FORMAT_OPERAND_IMM, &hook);
         
     valid_ = true;
 }
 
 
-bool Architecturex86::fillBranchInfo(ZydisDecodedOperand& operand, InstructionInfo& iinfo, InstructionInfo::BranchType branchType)
+bool Architecturex86::fillBranchInfo(const ZydisDecodedInstruction& instruction, const ZydisDecodedOperand& operand, InstructionInfo& iinfo, InstructionInfo::BranchType branchType)
 {
-    if (branchType != InstructionInfo::BRANCH_TAKEN && branchType != InstructionInfo::BRANCH_NOTTAKEN)
-    {
-        return true;
-    }
     switch (operand.type)
     {
+        case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+        {
+            // Relative branches (rel8/rel32)
+            uint64_t target;
+            if (!ZYDIS_SUCCESS(ZydisCalcAbsoluteAddress(&instruction, &operand, &target)))
+            {
+                return false;
+            }
+            iinfo.setBranch(branchType, target);
+            break;
+        }
         case ZYDIS_OPERAND_TYPE_MEMORY:
+        {
+            // Absolute and RIP-relative slots (e.g. import thunks) have a
+            // known address; otherwise record the base register
+            uint64_t slot;
+            if (operand.mem.index == ZYDIS_REGISTER_NONE &&
+                (operand.mem.base == ZYDIS_REGISTER_NONE || operand.mem.base == ZYDIS_REGISTER_RIP || operand.mem.base == ZYDIS_REGISTER_EIP) &&
+                ZYDIS_SUCCESS(ZydisCalcAbsoluteAddress(&instruction, &operand, &slot)))
+            {
+                iinfo.setBranch(static_cast<InstructionInfo::BranchType>(branchType | InstructionInfo::BRANCH_INDIRECT), slot);
+                break;
+            }
             // TODO: scale and index will matter in 16bit mode
-            iinfo.setBranch(branchType, operand.mem.base);
+            iinfo.setBranch(static_cast<InstructionInfo::BranchType>(branchType | InstructionInfo::BRANCH_TAKEN_REG), operand.mem.base);
             break;
+        }
         case ZYDIS_OPERAND_TYPE_POINTER:
             iinfo.setBranch(branchType, operand.ptr.offset);
             break;
         case ZYDIS_OPERAND_TYPE_REGISTER:
-            InstructionInfo::BranchType type;
-            
-            if (branchType == InstructionInfo::BRANCH_ALWAYS)
-            {
-                branchType = static_cast<InstructionInfo::BranchType>(static_cast<int>(branchType) | InstructionInfo::BRANCH_ALWAYS_REG);
-            }
-            else if (branchType == InstructionInfo::BRANCH_NOTTAKEN)
-            {
-                branchType = static_cast<InstructionInfo::BranchType>(static_cast<int>(branchType) | InstructionInfo::BRANCH_NOTTAKEN_REG);
-            }
-            
-            iinfo.setBranch(branchType, operand.reg.value);
+            iinfo.setBranch(static_cast<InstructionInfo::BranchType>(branchType | InstructionInfo::BRANCH_TAKEN_REG), operand.reg.value);
             break;
         default:
             Log::error("Unsupported operand type for branch instruction");
@@ -86,64 +96,165 @@ bool Architecturex86::instructionInfo(uint64_t instructionPointer, const char* d
     ZydisDecodedInstruction instruction;
     if (ZYDIS_SUCCESS(ZydisDecoderDecodeBuffer(&decoder_, data, size, instructionPointer, &instruction)))
     {
-        iinfo.setLength(instruction.length);
+        return fillInstructionInfo(instruction, instructionPointer, iinfo);
+    }
+
+    return false;
+}
+
+
+std::size_t Architecturex86::decodeBatch(uint64_t instructionPointer, const char* data, std::size_t size, DecodedInstruction* records, std::size_t count, char* text, std::size_t textStride)
+{
+    std::size_t offset = 0;
+    std::size_t decoded = 0;
+    
+    ZydisDecodedInstruction instruction;
+    while (decoded < count && offset < size)
+    {
+        uint64_t address = instructionPointer + offset;
+        if (!ZYDIS_SUCCESS(ZydisDecoderDecodeBuffer(&decoder_, data + offset, size - offset, address, &instruction)))
+        {
+            break;
+        }
+        
+        InstructionInfo iinfo;
+        if (!fillInstructionInfo(instruction, address, iinfo))
+        {
+            break;
+        }
+        
+        DecodedInstruction &record = records[decoded];
+        record.address = address;
+        record.target = iinfo.branch(0);
+        record.dataReference = iinfo.dataReference();
+        record.length = instruction.length;
+        record.branchTypes = iinfo.branchTypes();
+        
+        if (text != nullptr)
+        {
+            ZydisFormatterFormatInstruction(&formatter_, &instruction, text + decoded * textStride, textStride);
+        }
         
-        switch (instruction.mnemonic)
+        offset += instruction.length;
+        ++decoded;
+    }
+    
+    return decoded;
+}
+
+
+bool Architecturex86::fillInstructionInfo(const ZydisDecodedInstruction& instruction, uint64_t instructionPointer, InstructionInfo& iinfo)
+{
+    iinfo.setLength(instruction.length);
+    
+    // The first memory operand with an address known without executing.
+    // fs and gs point at per-thread blocks outside the image
+    for (uint8_t i = 0; i < instruction.operandCount; ++i)
+    {
+        const ZydisDecodedOperand &operand = instruction.operands[i];
+        if (operand.type != ZYDIS_OPERAND_TYPE_MEMORY || operand.visibility == ZYDIS_OPERAND_VISIBILITY_HIDDEN ||
+            operand.mem.index != ZYDIS_REGISTER_NONE ||
+            operand.mem.segment == ZYDIS_REGISTER_FS || operand.mem.segment == ZYDIS_REGISTER_GS)
+        {
+            continue;
+        }
+        
+        uint64_t address;
+        if ((operand.mem.base == ZYDIS_REGISTER_NONE || operand.mem.base == ZYDIS_REGISTER_RIP || operand.mem.base == ZYDIS_REGISTER_EIP) &&
+            ZYDIS_SUCCESS(ZydisCalcAbsoluteAddress(&instruction, &operand, &address)) && address != 0)
+        {
+            iinfo.setDataReference(address);
+            break;
+        }
+    }
+    
+    // Branch targets are always the first operand. Zydis also lists
+    // hidden operands (the instruction pointer, flags and stack)
+    const ZydisDecodedOperand &op = instruction.operands[0];
+    bool hasTarget = instruction.operandCount >= 1 && op.visibility == ZYDIS_OPERAND_VISIBILITY_EXPLICIT;
+    
+    switch (instruction.mnemonic)
+    {
+        case ZYDIS_MNEMONIC_JMP:
         {
-            case ZYDIS_MNEMONIC_JMP:
+            if (hasTarget)
             {
-                if (instruction.operandCount == 1)
+                if (!fillBranchInfo(instruction, op, iinfo, InstructionInfo::BRANCH_ALWAYS))
                 {
-                    ZydisDecodedOperand &op = instruction.operands[0];
-                    if (!fillBranchInfo(op, iinfo, InstructionInfo::BRANCH_ALWAYS))
-                    {
-                        return false;
-                    }
+                    return false;
                 }
-                break;
             }
+            break;
+        }
         
-            case ZYDIS_MNEMONIC_JB: // jc, jnae
-            case ZYDIS_MNEMONIC_JBE: // jna
-            case ZYDIS_MNEMONIC_JCXZ:
-            case ZYDIS_MNEMONIC_JECXZ:
-            case ZYDIS_MNEMONIC_JRCXZ:
-            case ZYDIS_MNEMONIC_JKNZD:
-            case ZYDIS_MNEMONIC_JKZD:
-            case ZYDIS_MNEMONIC_JL: // jnge
-            case ZYDIS_MNEMONIC_JLE: // jng
-            case ZYDIS_MNEMONIC_JNB: // jae, jnc
-            case ZYDIS_MNEMONIC_JNBE: // ja
-            
-            case ZYDIS_MNEMONIC_JNL: // jge
-            case ZYDIS_MNEMONIC_JNLE: // jg
-            
-            case ZYDIS_MNEMONIC_JNO:
-            case ZYDIS_MNEMONIC_JNP: // jpo
-            case ZYDIS_MNEMONIC_JNS:
-            
-            case ZYDIS_MNEMONIC_JNZ: // jne
-            case ZYDIS_MNEMONIC_JO:
-            case ZYDIS_MNEMONIC_JP: // jpe
-            case ZYDIS_MNEMONIC_JS:
-            case ZYDIS_MNEMONIC_JZ:
+        case ZYDIS_MNEMONIC_CALL:
+        {
+            if (hasTarget)
             {
-                if (instruction.operandCount == 1)
+                if (!fillBranchInfo(instruction, op, iinfo, static_cast<InstructionInfo::BranchType>(InstructionInfo::BRANCH_ALWAYS | InstructionInfo::BRANCH_CALL)))
                 {
-                    ZydisDecodedOperand &op = instruction.operands[0];
-                    if (!fillBranchInfo(op, iinfo, InstructionInfo::BRANCH_TAKEN))
-                    {
-                        return false;
-                    }
+                    return false;
                 }
-                break;
             }
+            break;
         }
         
-        return true;
+        case ZYDIS_MNEMONIC_RET:
+        case ZYDIS_MNEMONIC_IRET:
+        case ZYDIS_MNEMONIC_IRETD:
+        case ZYDIS_MNEMONIC_IRETQ:
+        case ZYDIS_MNEMONIC_HLT:
+        case ZYDIS_MNEMONIC_UD2:
+            iinfo.setBranch(InstructionInfo::BRANCH_STOP, 0);
+            break;
+    
+        case ZYDIS_MNEMONIC_JB: // jc, jnae
+        case ZYDIS_MNEMONIC_JBE: // jna
+        case ZYDIS_MNEMONIC_JCXZ:
+        case ZYDIS_MNEMONIC_JECXZ:
+        case ZYDIS_MNEMONIC_JRCXZ:
+        case ZYDIS_MNEMONIC_JKNZD:
+        case ZYDIS_MNEMONIC_JKZD:
+        case ZYDIS_MNEMONIC_JL: // jnge
+        case ZYDIS_MNEMONIC_JLE: // jng
+        case ZYDIS_MNEMONIC_JNB: // jae, jnc
+        case ZYDIS_MNEMONIC_JNBE: // ja
+        
+        case ZYDIS_MNEMONIC_JNL: // jge
+        case ZYDIS_MNEMONIC_JNLE: // jg
+        
+        case ZYDIS_MNEMONIC_JNO:
+        case ZYDIS_MNEMONIC_JNP: // jpo
+        case ZYDIS_MNEMONIC_JNS:
+        
+        case ZYDIS_MNEMONIC_JNZ: // jne
+        case ZYDIS_MNEMONIC_JO:
+        case ZYDIS_MNEMONIC_JP: // jpe
+        case ZYDIS_MNEMONIC_JS:
+        case ZYDIS_MNEMONIC_JZ:
+        
+        case ZYDIS_MNEMONIC_LOOP:
+        case ZYDIS_MNEMONIC_LOOPE:
+        case ZYDIS_MNEMONIC_LOOPNE:
+        {
+            if (hasTarget)
+            {
+                if (!fillBranchInfo(instruction, op, iinfo, InstructionInfo::BRANCH_TAKEN))
+                {
+                    return false;
+                }
+            }
+            iinfo.setBranch(InstructionInfo::BRANCH_NOTTAKEN, instructionPointer + instruction.length);
+            break;
+        }
     }
+    
+    return true;
+}
 
-    return false;
+std::shared_ptr<Architecture> Architecturex86::clone() const
+{
+    return std::make_shared<Architecturex86>(*this);
 }
 
 bool Architecturex86::registerName(uint16_t id, std::string& name)
@@ -159,74 +270,360 @@ bool Architecturex86::registerName(uint16_t id, std::string& name)
 }
 
 
-bool Architecturex86::instructionText(uint64_t instructionPointer, const char* data, std::size_t size, std::vector< Architecture::Token >& tokens)
+namespace
 {
-    ZydisDecodedInstruction instruction;
-    if (ZYDIS_SUCCESS(ZydisDecoderDecodeBuffer(&decoder_, data, size, instructionPointer, &instruction)))
+// Collects the tokens recorded by the formatter hooks for one instruction.
+// Lives on the stack of instructionText
+struct FormatContext
+{
+    const char *base;
+    // Names addresses, or null
+    const SymbolResolver *symbols;
+    Architecture::Token tokens[Architecture::TokenList::MAX_TOKENS];
+    size_t count;
+};
+
+// Writes text at *buffer, advances it and keeps the output null-terminated
+ZydisStatus print(char **buffer, const char *end, const char *text, size_t length)
+{
+    if (length >= static_cast<size_t>(end - *buffer))
     {
-        char buffer[256];
-        ZydisFormatterFormatInstruction(&formatter_, &instruction, buffer, sizeof(buffer));
-        
-        Architecture::Token token;
-        token.type = Architecture::Token::TYPE_TEXT;
-        token.text = std::string(buffer);
-        
-        tokens.push_back(std::move(token));
-        
-        return true;
+        return ZYDIS_STATUS_INSUFFICIENT_BUFFER_SIZE;
     }
-    
-    return false;
+    memcpy(*buffer, text, length);
+    *buffer += length;
+    **buffer = '\0';
+    return ZYDIS_STATUS_SUCCESS;
 }
 
-
-
-ZydisStatus Architecturex86::hookFormatOperandImm(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+ZydisStatus print(char **buffer, const char *end, const char *text)
 {
-    std::vector<Architecture::Token> *tokens = reinterpret_cast<std::vector<Architecture::Token>*>(userData);
-    
-    // operand->imm.
-    
-    return ZYDIS_STATUS_SUCCESS;
+    return print(buffer, end, text, strlen(text));
 }
 
-
-ZydisStatus Architecturex86::hookFormatOperandMem(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+ZydisStatus printHex(char **buffer, const char *end, uint64_t value)
 {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(value));
+    return print(buffer, end, text, length);
 }
 
-
-ZydisStatus Architecturex86::hookFormatOperandPtr(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+// Records a token for the text written since start
+void addToken(void *userData, const char *start, const char *end, Architecture::Token::Type type, uint64_t value)
 {
+    FormatContext *context = reinterpret_cast<FormatContext*>(userData);
+    if (context == nullptr || context->count == Architecture::TokenList::MAX_TOKENS)
+    {
+        return;
+    }
+    
+    Architecture::Token &token = context->tokens[context->count++];
+    token.type = type;
+    token.valueType = Architecture::Token::TYPE_INTEGER;
+    token.offset = static_cast<uint16_t>(start - context->base);
+    token.length = static_cast<uint16_t>(end - start);
+    switch (type)
+    {
+        case Architecture::Token::TYPE_REGISTER:
+            token.reg = static_cast<uint16_t>(value);
+            break;
+        case Architecture::Token::TYPE_CONSTANT:
+            token.constant = static_cast<int64_t>(value);
+            break;
+        default:
+            token.address = value;
+            break;
+    }
 }
 
+// Looks up the symbol at address through the context's resolver
+bool symbolAt(void *userData, uint64_t address, const char *&name, size_t &length)
+{
+    const FormatContext *context = reinterpret_cast<const FormatContext*>(userData);
+    return context != nullptr && context->symbols != nullptr && context->symbols->symbolAt(address, name, length);
+}
 
-ZydisStatus Architecturex86::hookFormatOperandReg(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+// Appends a TYPE_TEXT token for text[from, to) if it is not empty
+void appendText(Architecture::TokenList &tokens, size_t from, size_t to, Architecture::Token::Type type = Architecture::Token::TYPE_TEXT)
 {
+    if (from >= to)
+    {
+        return;
+    }
+    Architecture::Token token;
+    token.type = type;
+    token.valueType = Architecture::Token::TYPE_STRING;
+    token.offset = static_cast<uint16_t>(from);
+    token.length = static_cast<uint16_t>(to - from);
+    token.address = 0;
+    tokens.append(token);
+}
 }
 
 
-ZydisStatus Architecturex86::hookFormatPrintDecorator(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+bool Architecturex86::instructionText(uint64_t instructionPointer, const char* data, std::size_t size, Architecture::TokenList& tokens)
 {
+    tokens.clear();
+    
+    ZydisDecodedInstruction instruction;
+    if (!ZYDIS_SUCCESS(ZydisDecoderDecodeBuffer(&decoder_, data, size, instructionPointer, &instruction)))
+    {
+        return false;
+    }
+    
+    FormatContext context;
+    context.base = tokens.buffer();
+    context.symbols = symbols_.get();
+    context.count = 0;
+    if (!ZYDIS_SUCCESS(ZydisFormatterFormatInstructionEx(&formatter_, &instruction, tokens.buffer(), TokenList::MAX_TEXT, &context)))
+    {
+        return false;
+    }
+    
+    const char *text = tokens.text();
+    size_t length = strlen(text);
+    
+    // The mnemonic is the first word matching the mnemonic string; anything
+    // before it is prefixes
+    size_t position = 0;
+    const char *mnemonic = ZydisMnemonicGetString(instruction.mnemonic);
+    if (mnemonic != nullptr)
+    {
+        const char *found = strstr(text, mnemonic);
+        size_t operandsStart = context.count > 0 ? context.tokens[0].offset : length;
+        if (found != nullptr && static_cast<size_t>(found - text) < operandsStart)
+        {
+            size_t start = found - text;
+            appendText(tokens, 0, start);
+            appendText(tokens, start, start + strlen(mnemonic), Token::TYPE_MNEMONIC);
+            position = start + strlen(mnemonic);
+        }
+    }
+    
+    // Fill the gaps between the operand tokens (separators, size and
+    // segment prefixes) with text tokens
+    for (size_t i = 0; i < context.count; ++i)
+    {
+        const Token &token = context.tokens[i];
+        appendText(tokens, position, token.offset);
+        tokens.append(token);
+        position = token.offset + token.length;
+    }
+    appendText(tokens, position, length);
+    
+    return true;
 }
 
 
-ZydisStatus Architecturex86::hookFormatPrintDisplacement(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+
+ZydisStatus Architecturex86::hookFormatOperandImm(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
 {
+    const char *start = *buffer;
+    const char *end = *buffer + bufferLen;
+    
+    if (operand->imm.isRelative)
+    {
+        uint64_t address;
+        ZydisStatus status = ZydisCalcAbsoluteAddress(instruction, operand, &address);
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        status = printHex(buffer, end, address);
+        if (ZYDIS_SUCCESS(status))
+        {
+            addToken(userData, start, *buffer, Token::TYPE_ADDRESS, address);
+        }
+        return status;
+    }
+    
+    ZydisStatus status;
+    if (operand->imm.isSigned && operand->imm.value.s < 0)
+    {
+        status = print(buffer, end, "-");
+        if (ZYDIS_SUCCESS(status))
+        {
+            status = printHex(buffer, end, -static_cast<uint64_t>(operand->imm.value.s));
+        }
+    }
+    else
+    {
+        status = printHex(buffer, end, operand->imm.value.u);
+    }
+    
+    if (ZYDIS_SUCCESS(status))
+    {
+        addToken(userData, start, *buffer, Token::TYPE_CONSTANT, operand->imm.value.u);
+    }
+    return status;
 }
 
 
-ZydisStatus Architecturex86::hookFormatPrintImmediate(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+ZydisStatus Architecturex86::hookFormatOperandMem(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
 {
+    const char *end = *buffer + bufferLen;
+    ZydisStatus status;
+    
+    // The operand size (e.g. "dword ptr ") is printed by Zydis before
+    // this hook. Only fs and gs overrides carry meaning in flat memory
+    if (operand->mem.segment == ZYDIS_REGISTER_FS || operand->mem.segment == ZYDIS_REGISTER_GS)
+    {
+        const char *start = *buffer;
+        status = print(buffer, end, ZydisRegisterGetString(operand->mem.segment));
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        addToken(userData, start, *buffer, Token::TYPE_REGISTER, operand->mem.segment);
+        status = print(buffer, end, ":");
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+    }
+    
+    status = print(buffer, end, "[");
+    if (!ZYDIS_SUCCESS(status))
+    {
+        return status;
+    }
+    
+    // Absolute and RIP-relative operands are shown as the symbol or
+    // address they refer to
+    uint64_t address;
+    if (operand->mem.index == ZYDIS_REGISTER_NONE &&
+        (operand->mem.base == ZYDIS_REGISTER_NONE || operand->mem.base == ZYDIS_REGISTER_RIP || operand->mem.base == ZYDIS_REGISTER_EIP) &&
+        ZYDIS_SUCCESS(ZydisCalcAbsoluteAddress(instruction, operand, &address)))
+    {
+        const char *start = *buffer;
+        const char *name;
+        size_t length;
+        if (symbolAt(userData, address, name, length))
+        {
+            status = print(buffer, end, name, length);
+        }
+        else
+        {
+            status = printHex(buffer, end, address);
+        }
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        addToken(userData, start, *buffer, Token::TYPE_ADDRESS, address);
+        return print(buffer, end, "]");
+    }
+    
+    bool empty = true;
+    if (operand->mem.base != ZYDIS_REGISTER_NONE)
+    {
+        const char *start = *buffer;
+        status = print(buffer, end, ZydisRegisterGetString(operand->mem.base));
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        addToken(userData, start, *buffer, Token::TYPE_REGISTER, operand->mem.base);
+        empty = false;
+    }
+    
+    if (operand->mem.index != ZYDIS_REGISTER_NONE)
+    {
+        if (!empty)
+        {
+            status = print(buffer, end, "+");
+            if (!ZYDIS_SUCCESS(status))
+            {
+                return status;
+            }
+        }
+        const char *start = *buffer;
+        status = print(buffer, end, ZydisRegisterGetString(operand->mem.index));
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        addToken(userData, start, *buffer, Token::TYPE_REGISTER, operand->mem.index);
+        if (operand->mem.scale > 1)
+        {
+            char scale[4] = {'*', static_cast<char>('0' + operand->mem.scale), '\0'};
+            status = print(buffer, end, scale);
+            if (!ZYDIS_SUCCESS(status))
+            {
+                return status;
+            }
+        }
+        empty = false;
+    }
+    
+    int64_t displacement = operand->mem.disp.hasDisplacement ? operand->mem.disp.value : 0;
+    if (displacement != 0 || empty)
+    {
+        if (!empty)
+        {
+            status = print(buffer, end, displacement < 0 ? "-" : "+");
+            if (!ZYDIS_SUCCESS(status))
+            {
+                return status;
+            }
+        }
+        const char *start = *buffer;
+        uint64_t magnitude = displacement < 0 ? -static_cast<uint64_t>(displacement) : displacement;
+        status = printHex(buffer, end, magnitude);
+        if (!ZYDIS_SUCCESS(status))
+        {
+            return status;
+        }
+        addToken(userData, start, *buffer, Token::TYPE_CONSTANT, displacement);
+    }
+    
+    return print(buffer, end, "]");
 }
 
 
-ZydisStatus Architecturex86::hookFormatPrintOperandSize(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+ZydisStatus Architecturex86::hookFormatOperandPtr(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
 {
+    const char *end = *buffer + bufferLen;
+    
+    const char *start = *buffer;
+    ZydisStatus status = printHex(buffer, end, operand->ptr.segment);
+    if (!ZYDIS_SUCCESS(status))
+    {
+        return status;
+    }
+    addToken(userData, start, *buffer, Token::TYPE_CONSTANT, operand->ptr.segment);
+    
+    status = print(buffer, end, ":");
+    if (!ZYDIS_SUCCESS(status))
+    {
+        return status;
+    }
+    
+    start = *buffer;
+    status = printHex(buffer, end, operand->ptr.offset);
+    if (!ZYDIS_SUCCESS(status))
+    {
+        return status;
+    }
+    addToken(userData, start, *buffer, Token::TYPE_ADDRESS, operand->ptr.offset);
+    return ZYDIS_STATUS_SUCCESS;
 }
 
 
-ZydisStatus Architecturex86::hookFormatPrintSegment(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
+ZydisStatus Architecturex86::hookFormatOperandReg(const ZydisFormatter* formatter, char ** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand, void* userData)
 {
+    const char *end = *buffer + bufferLen;
+    const char *name = ZydisRegisterGetString(operand->reg.value);
+    if (name == nullptr)
+    {
+        return ZYDIS_STATUS_INVALID_PARAMETER;
+    }
+    
+    const char *start = *buffer;
+    ZydisStatus status = print(buffer, end, name);
+    if (ZYDIS_SUCCESS(status))
+    {
+        addToken(userData, start, *buffer, Token::TYPE_REGISTER, operand->reg.value);
+    }
+    return status;
 }
-
@@ -17,10 +17,14 @@ public:
     
     bool instructionInfo(uint64_t instructionPointer, const char * data, std::size_t size, InstructionInfo & iinfo) override;
     
-    bool instructionText(uint64_t instructionPointer, const char * data, std::size_t size, std::vector<Token> & tokens) override;
+    bool instructionText(uint64_t instructionPointer, const char * data, std::size_t size, TokenList & tokens) override;
+    
+    std::size_t decodeBatch(uint64_t instructionPointer, const char * data, std::size_t size, DecodedInstruction * records, std::size_t count, char * text = nullptr, std::size_t textStride = 0) override;
     
     bool registerName(uint16_t id, std::string & name) override;
     
+    std::shared_ptr<Architecture> clone() const override;
+    
     
     inline bool valid()
     {
@@ -28,7 +32,8 @@ public:
     }
     
     
-    /* Zydis formatter hooks */
+    /* Zydis formatter hooks. Each one formats an operand itself and, when
+     * userData is a formatting context, records a token for it */
     static ZydisStatus hookFormatOperandReg(const ZydisFormatter* formatter, 
                                             char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
                                             const ZydisDecodedOperand* operand, void* userData);
@@ -45,35 +50,19 @@ public:
                                             char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
                                             const ZydisDecodedOperand* operand, void* userData);
     
-    static ZydisStatus hookFormatPrintOperandSize(const ZydisFormatter* formatter, 
-                                            char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
-                                            const ZydisDecodedOperand* operand, void* userData);
-    
-    static ZydisStatus hookFormatPrintSegment(const ZydisFormatter* formatter, 
-                                          char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
-                                          const ZydisDecodedOperand* operand, void* userData);
-    
-    static ZydisStatus hookFormatPrintDecorator(const ZydisFormatter* formatter, 
-                                          char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
-                                          const ZydisDecodedOperand* operand, void* userData);
-    
-    static ZydisStatus hookFormatPrintDisplacement(const ZydisFormatter* formatter, 
-                                          char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
-                                          const ZydisDecodedOperand* operand, void* userData);
-    
-    static ZydisStatus hookFormatPrintImmediate(const ZydisFormatter* formatter, 
-                                          char** buffer, size_t bufferLen, const ZydisDecodedInstruction* instruction, 
-                                          const ZydisDecodedOperand* operand, void* userData);
-    
 private:
     ZydisDecoder decoder_;
     ZydisFormatter formatter_;
     bool valid_;
     
     
+    // Fills the length and branch info of a decoded instruction
+    // returns true on success
+    bool fillInstructionInfo(const ZydisDecodedInstruction &instruction, uint64_t instructionPointer, InstructionInfo &iinfo);
+    
     // Fills the branch info for an operand into the instruction info
     // returns true on success
-    bool fillBranchInfo(ZydisDecodedOperand &operand, InstructionInfo &iinfo, InstructionInfo::BranchType bdranchType);
+    bool fillBranchInfo(const ZydisDecodedInstruction &instruction, const ZydisDecodedOperand &operand, InstructionInfo &iinfo, InstructionInfo::BranchType branchType);
 };
 
 #endif // ARCHITECTUREX86_H
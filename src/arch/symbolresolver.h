@@ -0,0 +1,22 @@
+#ifndef SYMBOLRESOLVER_H
+#define SYMBOLRESOLVER_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* Names addresses while instructions are formatted. A lookup can run for
+ * every operand of every row drawn, so implementations should answer
+ * without allocating or locking */
+class SymbolResolver
+{
+public:
+    virtual ~SymbolResolver() {}
+    
+    /* Finds the symbol at address. Returns true and sets name to its text,
+     * length characters that stay valid as long as the resolver does */
+    virtual bool symbolAt(uint64_t address, const char *&name, std::size_t &length) const =0;
+};
+
+typedef std::shared_ptr<const SymbolResolver> SymbolResolverPtr;
+
+#endif // SYMBOLRESOLVER_H
@@ -0,0 +1,261 @@
+#include "batchanalyzer.h"
+#include "disasm/instructioninfo.h"
+#include "disassembler.h"
+#include "log.h"
+#include "pe/exporttable.h"
+#include "pe/importtable.h"
+#include "pe/pefile.h"
+#include "pe/relocationtable.h"
+#include "pe/resourcetree.h"
+#include "sectionhandler.h"
+#include "stringscanner.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+BatchAnalyzer::BatchAnalyzer(FILE *output) : output_(output), threadCount_(0)
+{
+}
+
+void BatchAnalyzer::setThreadCount(unsigned count)
+{
+    threadCount_ = count;
+}
+
+void BatchAnalyzer::addPath(const QString &path)
+{
+    QFileInfo info(path);
+    if (!info.isDir())
+    {
+        files_.append(path);
+        return;
+    }
+
+    QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        files_.append(it.next());
+    }
+}
+
+bool BatchAnalyzer::addList(const QString &listPath)
+{
+    QFile list(listPath);
+    if (!list.open(QFile::ReadOnly | QFile::Text))
+    {
+        Log::error(QString("Failed to open file list: ") + list.errorString());
+        return false;
+    }
+
+    QTextStream stream(&list);
+    while (!stream.atEnd())
+    {
+        QString line = stream.readLine().trimmed();
+        if (!line.isEmpty())
+        {
+            addPath(line);
+        }
+    }
+
+    return true;
+}
+
+unsigned BatchAnalyzer::run()
+{
+    unsigned threadCount = threadCount_;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::atomic<int> next(0);
+    std::atomic<unsigned> failed(0);
+
+    auto worker = [&]() {
+        for (int i = next++; i < files_.size(); i = next++)
+        {
+            QJsonObject result = analyze(files_[i]);
+            if (!result.value("valid").toBool())
+            {
+                ++failed;
+            }
+            writeResult(result);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    return failed;
+}
+
+QJsonObject BatchAnalyzer::analyze(const QString &path)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    QJsonObject result;
+    result.insert("path", path);
+    result.insert("valid", false);
+
+    MappedFilePtr file = std::make_shared<MappedFile>();
+    if (!file->open(path))
+    {
+        return result;
+    }
+    result.insert("size", static_cast<double>(file->size()));
+
+    PEFilePtr pefile = std::make_shared<PEFile>();
+    if (!pefile->parse(file))
+    {
+        return result;
+    }
+
+    const CoffFile::OptionalHeader &optional = pefile->optionalHeader_;
+    result.insert("machine", CoffFile::machineString(
+                                 static_cast<CoffFile::MachineType>(
+                                     pefile->coffHeader_.machine)));
+    result.insert("timeDateStamp",
+                  static_cast<double>(pefile->coffHeader_.timeDateStamp));
+    if (pefile->optionalHeaderExists_)
+    {
+        result.insert("imageBase",
+                      QStringLiteral("0x%1").arg(optional.imageBase, 0, 16));
+        result.insert("entryPoint",
+                      QStringLiteral("0x%1").arg(
+                          optional.addressOfEntryPoint, 0, 16));
+    }
+
+    QJsonArray sections;
+    for (const CoffFile::SectionHeader &header : pefile->sectionTable_)
+    {
+        sections.append(QString::fromLatin1(header.name));
+    }
+    result.insert("sections", sections);
+
+    ImportTable imports;
+    if (imports.parse(*pefile))
+    {
+        result.insert("imports", static_cast<double>(imports.size()));
+    }
+
+    RelocationTable relocations;
+    if (relocations.parse(*pefile))
+    {
+        result.insert("relocations", static_cast<double>(relocations.size()));
+    }
+
+    ResourceTree resources;
+    if (resources.parse(*pefile))
+    {
+        result.insert("resources",
+                      static_cast<double>(resources.leafCount()));
+    }
+
+    // Files are already analyzed in parallel, so one thread each
+    StringScanner strings;
+    strings.scan(pefile->sections(), 1);
+    result.insert("strings", static_cast<double>(strings.strings().size()));
+
+    ExportTable exports;
+    if (exports.parse(*pefile))
+    {
+        result.insert("exports", static_cast<double>(exports.size()));
+    }
+
+    // Linear sweep over the executable sections
+    ArchitecturePtr arch = pefile->createArchitecture();
+    if (arch)
+    {
+        SectionHandler sectionHandler;
+        for (SectionPtr &section : pefile->sections())
+        {
+            sectionHandler.addSection(section);
+        }
+        sectionHandler.buildIndex();
+
+        Disassembler disassembler(&sectionHandler);
+        disassembler.setArchitecture(arch, optional.imageBase);
+        disassembler.linearSweep();
+
+        std::vector<CoffFile::RuntimeFunction> runtimeFunctions;
+        pefile->runtimeFunctions(runtimeFunctions);
+        for (const CoffFile::RuntimeFunction &function : runtimeFunctions)
+        {
+            disassembler.addFunction(optional.imageBase + function.beginAddress,
+                                     optional.imageBase + function.endAddress,
+                                     FunctionTable::SOURCE_EXCEPTION);
+        }
+        for (size_t i = 0; i < exports.size(); ++i)
+        {
+            SectionPtr section = sectionHandler.find(exports[i].rva);
+            if (!exports[i].forwarded() && section && section->executable())
+            {
+                disassembler.addFunction(optional.imageBase + exports[i].rva,
+                                         0, FunctionTable::SOURCE_EXPORT);
+            }
+        }
+        if (optional.addressOfEntryPoint != 0)
+        {
+            disassembler.addFunction(optional.imageBase +
+                                         optional.addressOfEntryPoint,
+                                     0, FunctionTable::SOURCE_ENTRY);
+        }
+
+        const InstructionStore &instructions = disassembler.instructions();
+        uint64_t branches = 0;
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            if (InstructionInfo::hasTarget(instructions.branchTypes(i)))
+            {
+                ++branches;
+            }
+        }
+        result.insert("instructions",
+                      static_cast<double>(instructions.size()));
+        result.insert("branches", static_cast<double>(branches));
+
+        disassembler.buildGraph();
+        result.insert("blocks",
+                      static_cast<double>(disassembler.graph().blockCount()));
+        result.insert("edges",
+                      static_cast<double>(disassembler.graph().edgeCount()));
+
+        disassembler.discoverFunctions(runtimeFunctions.empty());
+        result.insert("functions",
+                      static_cast<double>(disassembler.functions().size()));
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    result.insert("elapsedMs", static_cast<double>(elapsed.count()));
+    result.insert("valid", true);
+
+    return result;
+}
+
+void BatchAnalyzer::writeResult(const QJsonObject &result)
+{
+    QByteArray line = QJsonDocument(result).toJson(QJsonDocument::Compact);
+
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    fwrite(line.constData(), 1, line.size(), output_);
+    fputc('\n', output_);
+    fflush(output_);
+}
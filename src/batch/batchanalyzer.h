@@ -0,0 +1,42 @@
+#ifndef BATCHANALYZER_H
+#define BATCHANALYZER_H
+
+#include <QJsonObject>
+#include <QStringList>
+#include <cstdio>
+#include <mutex>
+
+/* Parses and disassembles many PE files in parallel without a GUI. Each
+ * file produces one JSON object written as a single line to the output */
+class BatchAnalyzer
+{
+public:
+    BatchAnalyzer(FILE *output);
+
+    /* Sets the number of worker threads. Zero uses one per core */
+    void setThreadCount(unsigned count);
+
+    /* Adds a file, or every file under a directory, to the input */
+    void addPath(const QString &path);
+
+    /* Adds every path listed in a file, one per line. Returns false if
+     * the list could not be read */
+    bool addList(const QString &listPath);
+
+    /* Analyzes all inputs and blocks until done. Returns the number of
+     * files that could not be analyzed */
+    unsigned run();
+
+private:
+    // Analyzes a single file. Called from the worker threads
+    QJsonObject analyze(const QString &path);
+
+    void writeResult(const QJsonObject &result);
+
+    FILE *output_;
+    unsigned threadCount_;
+    QStringList files_;
+    std::mutex outputMutex_;
+};
+
+#endif // BATCHANALYZER_H
@@ -0,0 +1,56 @@
+#include "batchanalyzer.h"
+#include "log.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ISABatch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Parses and disassembles PE files without a GUI. One JSON object "
+        "is written to stdout per file.");
+    parser.addHelpOption();
+
+    QCommandLineOption listOption(
+        QStringList() << "l"
+                      << "list",
+        "Read input paths from <file>, one per line.", "file");
+    parser.addOption(listOption);
+
+    QCommandLineOption jobsOption(
+        QStringList() << "j"
+                      << "jobs",
+        "Number of worker threads. Defaults to the number of cores.",
+        "count");
+    parser.addOption(jobsOption);
+
+    parser.addPositionalArgument("paths", "Files or directories to analyze.",
+                                 "[paths...]");
+    parser.process(app);
+
+    // stdout carries the results and the log model is GUI-only
+    Log::setModelEnabled(false);
+    Log::setNormalToStderr(true);
+
+    BatchAnalyzer analyzer(stdout);
+    if (parser.isSet(jobsOption))
+    {
+        analyzer.setThreadCount(parser.value(jobsOption).toUInt());
+    }
+
+    if (parser.isSet(listOption) &&
+        !analyzer.addList(parser.value(listOption)))
+    {
+        return 1;
+    }
+
+    for (const QString &path : parser.positionalArguments())
+    {
+        analyzer.addPath(path);
+    }
+
+    return analyzer.run() == 0 ? 0 : 1;
+}
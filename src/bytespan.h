@@ -0,0 +1,90 @@
+#ifndef BYTESPAN_H
+#define BYTESPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* A non-owning view of a contiguous range of bytes. Multi-byte reads are
+ * little-endian regardless of the host and are not bounds checked; check
+ * a whole structure once with contains() or sub() before reading it. */
+class ByteSpan
+{
+public:
+    ByteSpan() : data_(nullptr), size_(0)
+    {
+    }
+
+    ByteSpan(const char *data, size_t size) : data_(data), size_(size)
+    {
+    }
+
+    inline const char *data() const
+    {
+        return data_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    inline bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // Returns true if [offset, offset + size) lies inside the span
+    inline bool contains(size_t offset, size_t size) const
+    {
+        return offset <= size_ && size <= size_ - offset;
+    }
+
+    // Returns the bytes [offset, offset + size) or an empty span if they
+    // are out of bounds
+    inline ByteSpan sub(size_t offset, size_t size) const
+    {
+        if (!contains(offset, size))
+        {
+            return ByteSpan();
+        }
+        return ByteSpan(data_ + offset, size);
+    }
+
+    // Returns the bytes from offset to the end of the span
+    inline ByteSpan sub(size_t offset) const
+    {
+        if (offset > size_)
+        {
+            return ByteSpan();
+        }
+        return ByteSpan(data_ + offset, size_ - offset);
+    }
+
+    inline uint8_t u8(size_t offset) const
+    {
+        return static_cast<uint8_t>(data_[offset]);
+    }
+
+    inline uint16_t u16(size_t offset) const
+    {
+        return static_cast<uint16_t>(u8(offset) | (u8(offset + 1) << 8));
+    }
+
+    inline uint32_t u32(size_t offset) const
+    {
+        return static_cast<uint32_t>(u16(offset)) |
+               (static_cast<uint32_t>(u16(offset + 2)) << 16);
+    }
+
+    inline uint64_t u64(size_t offset) const
+    {
+        return static_cast<uint64_t>(u32(offset)) |
+               (static_cast<uint64_t>(u32(offset + 4)) << 32);
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+#endif // BYTESPAN_H
@@ -0,0 +1,723 @@
+#include "controlflowgraph.h"
+#include "instructioninfo.h"
+#include "projectdatabase.h"
+#include "xrefdatabase.h"
+#include <algorithm>
+
+// Instructions marked between looks at the cancel flag
+static const size_t CANCEL_INTERVAL = 1 << 16;
+
+namespace
+{
+// Returns true if no instruction can follow this one in the same block
+inline bool endsBlock(uint8_t branchTypes)
+{
+    if (branchTypes & (InstructionInfo::BRANCH_TAKEN | InstructionInfo::BRANCH_NOTTAKEN | InstructionInfo::BRANCH_STOP))
+    {
+        return true;
+    }
+    return (branchTypes & InstructionInfo::BRANCH_ALWAYS) && !(branchTypes & InstructionInfo::BRANCH_CALL);
+}
+
+// Returns true if execution can continue with the next instruction
+inline bool fallsThrough(uint8_t branchTypes)
+{
+    if (branchTypes & InstructionInfo::BRANCH_STOP)
+    {
+        return false;
+    }
+    return !(branchTypes & InstructionInfo::BRANCH_ALWAYS) || (branchTypes & InstructionInfo::BRANCH_CALL);
+}
+
+// Returns true if the instruction branches to a known address inside the
+// graph. Calls lead to other functions and indirect targets are slots
+inline bool branchesLocally(uint8_t branchTypes)
+{
+    return InstructionInfo::hasTarget(branchTypes) &&
+           !(branchTypes & (InstructionInfo::BRANCH_CALL | InstructionInfo::BRANCH_INDIRECT));
+}
+
+// A run [begin, end) of an array that is replaced by count values
+struct Piece
+{
+    size_t begin;
+    size_t end;
+    size_t count;
+};
+
+// An edge between new block numbers, while a graph is updated
+struct Link
+{
+    uint32_t from;
+    uint32_t to;
+    uint8_t type;
+};
+}
+
+/* Replaces pieces of values, which must be sorted and disjoint, by the
+ * values from replacements in order. What lies between them moves in place:
+ * runs that move left go first from the front, then runs that move right
+ * from the back, so no run is overwritten before it has moved */
+template <typename T>
+static void replacePieces(std::vector<T> &values, const std::vector<Piece> &pieces, const T *replacements)
+{
+    struct Run
+    {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+    std::vector<Run> runs;
+    size_t position = 0;
+    size_t moved = 0;
+    for (const Piece &piece : pieces)
+    {
+        Run run = {position, moved, piece.begin - position};
+        runs.push_back(run);
+        moved += run.size + piece.count;
+        position = piece.end;
+    }
+    Run last = {position, moved, values.size() - position};
+    runs.push_back(last);
+
+    size_t oldSize = values.size();
+    size_t newSize = moved + last.size;
+    if (newSize > oldSize)
+    {
+        values.resize(newSize);
+    }
+    for (const Run &run : runs)
+    {
+        if (run.to < run.from)
+        {
+            std::move(values.begin() + run.from, values.begin() + run.from + run.size, values.begin() + run.to);
+        }
+    }
+    for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+    {
+        if (run->to > run->from)
+        {
+            std::move_backward(values.begin() + run->from, values.begin() + run->from + run->size,
+                               values.begin() + run->to + run->size);
+        }
+    }
+    if (newSize < oldSize)
+    {
+        values.resize(newSize);
+    }
+
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        std::copy(replacements, replacements + pieces[i].count, values.begin() + runs[i].to + runs[i].size);
+        replacements += pieces[i].count;
+    }
+}
+
+/* Replaces the rows of the blocks in pieces of a compressed sparse row
+ * array. rows holds the new rows one after another and lengths their
+ * sizes, one per new block */
+static void replaceRows(std::vector<uint32_t> &offsets, std::vector<ControlFlowGraph::Edge> &edges,
+                        const std::vector<Piece> &pieces, const std::vector<uint32_t> &lengths,
+                        const std::vector<ControlFlowGraph::Edge> &rows)
+{
+    std::vector<Piece> spans;
+    size_t row = 0;
+    for (const Piece &piece : pieces)
+    {
+        Piece span = {offsets[piece.begin], offsets[piece.end], 0};
+        for (size_t i = 0; i < piece.count; ++i)
+        {
+            span.count += lengths[row++];
+        }
+        spans.push_back(span);
+    }
+    replacePieces(edges, spans, rows.data());
+
+    // Offsets become row lengths, one place on, so the same pieces of
+    // blocks can be replaced, and are summed up again
+    for (size_t block = offsets.size() - 1; block > 0; --block)
+    {
+        offsets[block] -= offsets[block - 1];
+    }
+    std::vector<Piece> shifted(pieces);
+    for (Piece &piece : shifted)
+    {
+        ++piece.begin;
+        ++piece.end;
+    }
+    replacePieces(offsets, shifted, lengths.data());
+    for (size_t block = 1; block < offsets.size(); ++block)
+    {
+        offsets[block] += offsets[block - 1];
+    }
+}
+
+ControlFlowGraph::ControlFlowGraph() : instructions_(nullptr)
+{
+}
+
+void ControlFlowGraph::clear()
+{
+    instructions_ = nullptr;
+    blockStarts_.clear();
+    successorOffsets_.clear();
+    successors_.clear();
+    predecessorOffsets_.clear();
+    predecessors_.clear();
+}
+
+bool ControlFlowGraph::build(const InstructionStore &instructions, const std::atomic<bool> *cancel)
+{
+    clear();
+    auto cancelled = [&]() {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+        {
+            clear();
+            return true;
+        }
+        return false;
+    };
+    instructions_ = &instructions;
+
+    size_t count = instructions.size();
+    if (count == 0)
+    {
+        return true;
+    }
+
+    // Mark the leaders
+    std::vector<uint8_t> leaders(count, 0);
+    leaders[0] = 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i % CANCEL_INTERVAL == 0 && cancelled())
+        {
+            return false;
+        }
+
+        uint8_t branchTypes = instructions.branchTypes(i);
+        if (i + 1 < count &&
+            (endsBlock(branchTypes) || instructions.address(i) + instructions.length(i) != instructions.address(i + 1)))
+        {
+            leaders[i + 1] = 1;
+        }
+
+        uint64_t target;
+        if (branchesLocally(branchTypes) && instructions.target(i, target))
+        {
+            size_t index = instructions.find(target);
+            if (index != InstructionStore::npos && instructions.address(index) == target)
+            {
+                leaders[index] = 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (leaders[i])
+        {
+            blockStarts_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    blockStarts_.push_back(static_cast<uint32_t>(count));
+
+    // Successors, in block order so the rows are written in place
+    size_t blocks = blockCount();
+    successorOffsets_.reserve(blocks + 1);
+    successors_.reserve(blocks * 2);
+    for (size_t block = 0; block < blocks; ++block)
+    {
+        if (cancelled())
+        {
+            return false;
+        }
+        successorOffsets_.push_back(static_cast<uint32_t>(successors_.size()));
+        addSuccessors(block, successors_);
+    }
+    successorOffsets_.push_back(static_cast<uint32_t>(successors_.size()));
+
+    linkPredecessors();
+    return true;
+}
+
+std::vector<ControlFlowGraph::Region> ControlFlowGraph::affectedRegions(
+    const std::vector<std::pair<uint64_t, uint64_t>> &ranges) const
+{
+    std::vector<Region> regions;
+    if (instructions_ == nullptr || blockCount() == 0)
+    {
+        return regions;
+    }
+
+    const InstructionStore &instructions = *instructions_;
+    size_t blocks = blockCount();
+    for (const std::pair<uint64_t, uint64_t> &range : ranges)
+    {
+        // From the block of the instruction before the range, whose
+        // fall-through can change. Regions from the first block also take
+        // in anything added before it...
+        Region region;
+        size_t first = instructions.lowerBound(range.first);
+        region.firstBlock = first == 0 ? 0 : blockOfInstruction(first - 1);
+        region.begin = region.firstBlock == 0 ? 0 : instructions.address(blockFirst(region.firstBlock));
+
+        // ...to the block of the instruction after it, which can start or
+        // stop being a leader
+        size_t last = instructions.lowerBound(range.second);
+        region.endBlock = last < instructions.size() ? blockOfInstruction(last) + 1 : blocks;
+        region.end = region.endBlock < blocks ? instructions.address(blockFirst(region.endBlock)) : UINT64_MAX;
+        regions.push_back(region);
+    }
+
+    std::sort(regions.begin(), regions.end(), [](const Region &a, const Region &b) {
+        return a.firstBlock < b.firstBlock;
+    });
+
+    size_t merged = 0;
+    for (size_t i = 1; i < regions.size(); ++i)
+    {
+        if (regions[i].firstBlock <= regions[merged].endBlock)
+        {
+            if (regions[i].endBlock > regions[merged].endBlock)
+            {
+                regions[merged].endBlock = regions[i].endBlock;
+                regions[merged].end = regions[i].end;
+            }
+        }
+        else
+        {
+            regions[++merged] = regions[i];
+        }
+    }
+    regions.resize(std::min(regions.size(), merged + 1));
+    return regions;
+}
+
+void ControlFlowGraph::update(const InstructionStore::Splice &splice, const std::vector<Region> &regions,
+                              const XrefDatabase &xrefs)
+{
+    if (instructions_ == nullptr)
+    {
+        return;
+    }
+
+    const InstructionStore &instructions = *instructions_;
+    size_t count = instructions.size();
+    if (blockCount() == 0 || count == 0 || regions.empty())
+    {
+        build(instructions);
+        return;
+    }
+
+    // Split the regions again. Branches into them may lead elsewhere now
+    std::vector<uint32_t> leaders;
+    std::vector<Piece> regionPieces;
+    std::vector<size_t> sources;
+    std::vector<XrefDatabase::Xref> references;
+    for (const Region &region : regions)
+    {
+        size_t before = leaders.size();
+        size_t first = instructions.lowerBound(region.begin);
+        size_t end = region.end == UINT64_MAX ? count : instructions.lowerBound(region.end);
+        for (size_t i = first; i < end; ++i)
+        {
+            bool leader = i == 0 || endsBlock(instructions.branchTypes(i - 1)) ||
+                          instructions.address(i - 1) + instructions.length(i - 1) != instructions.address(i);
+
+            xrefs.referencesTo(instructions.address(i), references);
+            for (const XrefDatabase::Xref &reference : references)
+            {
+                if (reference.type != XrefDatabase::XREF_JUMP && reference.type != XrefDatabase::XREF_BRANCH)
+                {
+                    continue;
+                }
+                size_t source = instructions.find(reference.from);
+                if (source != InstructionStore::npos && instructions.address(source) == reference.from)
+                {
+                    leader = true;
+                    sources.push_back(source);
+                }
+            }
+
+            if (leader)
+            {
+                leaders.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        Piece piece = {region.firstBlock, region.endBlock, leaders.size() - before};
+        regionPieces.push_back(piece);
+    }
+
+    // Blocks after a region move by the change in its number of blocks
+    size_t oldBlocks = blockCount();
+    std::vector<size_t> oldEnds;
+    std::vector<size_t> newEnds;
+    std::vector<int64_t> shifts(1, 0);
+    for (const Piece &piece : regionPieces)
+    {
+        shifts.push_back(shifts.back() + static_cast<int64_t>(piece.count) -
+                         static_cast<int64_t>(piece.end - piece.begin));
+        oldEnds.push_back(piece.end);
+        newEnds.push_back(piece.end + shifts.back());
+    }
+    auto inOldRegion = [&](size_t block) {
+        size_t r = std::upper_bound(oldEnds.begin(), oldEnds.end(), block) - oldEnds.begin();
+        return r < regionPieces.size() && block >= regionPieces[r].begin;
+    };
+    auto inNewRegion = [&](size_t block) {
+        size_t r = std::upper_bound(newEnds.begin(), newEnds.end(), block) - newEnds.begin();
+        return r < regionPieces.size() && block >= regionPieces[r].begin + shifts[r];
+    };
+    auto renumber = [&](size_t block) {
+        size_t r = std::upper_bound(oldEnds.begin(), oldEnds.end(), block) - oldEnds.begin();
+        return static_cast<uint32_t>(block + shifts[r]);
+    };
+    auto unnumber = [&](size_t block) {
+        size_t r = std::upper_bound(newEnds.begin(), newEnds.end(), block) - newEnds.begin();
+        return static_cast<uint32_t>(block - shifts[r]);
+    };
+
+    // Blocks outside the regions whose edges are found again: those that
+    // led into a region and those that branch into one now
+    std::vector<uint32_t> changed;
+    for (const Piece &piece : regionPieces)
+    {
+        for (uint32_t e = predecessorOffsets_[piece.begin]; e < predecessorOffsets_[piece.end]; ++e)
+        {
+            if (!inOldRegion(predecessors_[e].block))
+            {
+                changed.push_back(predecessors_[e].block);
+            }
+        }
+    }
+
+    // The other blocks keep their instructions, which have moved in the
+    // store. The splice positions are taken in order, as in a merge
+    size_t removed = splice.last - splice.first;
+    size_t position = 0;
+    size_t next = 0;
+    for (size_t block = regionPieces.front().begin; block < oldBlocks; ++block)
+    {
+        if (next < regionPieces.size() && block == regionPieces[next].begin)
+        {
+            block = regionPieces[next++].end - 1;
+            continue;
+        }
+        size_t remaining = blockStarts_[block] >= splice.last ? blockStarts_[block] - removed : blockStarts_[block];
+        while (position < splice.positions.size() && splice.positions[position] <= remaining)
+        {
+            ++position;
+        }
+        blockStarts_[block] = static_cast<uint32_t>(remaining + position);
+    }
+    replacePieces(blockStarts_, regionPieces, leaders.data());
+    blockStarts_.back() = static_cast<uint32_t>(count);
+
+    for (size_t source : sources)
+    {
+        size_t block = blockOfInstruction(source);
+        if (!inNewRegion(block))
+        {
+            changed.push_back(unnumber(block));
+        }
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    // Successor rows to replace, in block order: the regions and the
+    // changed blocks. Whatever their old edges led to loses a predecessor
+    std::vector<Piece> pieces;
+    std::vector<uint32_t> firsts;
+    std::vector<uint32_t> affected;
+    for (size_t r = 0, c = 0; r < regionPieces.size() || c < changed.size();)
+    {
+        Piece piece;
+        if (c == changed.size() || (r < regionPieces.size() && regionPieces[r].begin < changed[c]))
+        {
+            piece = regionPieces[r];
+            firsts.push_back(static_cast<uint32_t>(piece.begin + shifts[r]));
+            ++r;
+        }
+        else
+        {
+            piece.begin = changed[c];
+            piece.end = changed[c] + 1;
+            piece.count = 1;
+            firsts.push_back(renumber(changed[c]));
+            ++c;
+        }
+        pieces.push_back(piece);
+
+        for (uint32_t e = successorOffsets_[piece.begin]; e < successorOffsets_[piece.end]; ++e)
+        {
+            if (!inOldRegion(successors_[e].block))
+            {
+                affected.push_back(successors_[e].block);
+            }
+        }
+    }
+
+    std::vector<uint32_t> lengths;
+    std::vector<Edge> rows;
+    std::vector<Link> links;
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        for (size_t block = firsts[i]; block < firsts[i] + pieces[i].count; ++block)
+        {
+            size_t before = rows.size();
+            addSuccessors(block, rows);
+            lengths.push_back(static_cast<uint32_t>(rows.size() - before));
+            for (size_t e = before; e < rows.size(); ++e)
+            {
+                Link link = {static_cast<uint32_t>(block), rows[e].block, rows[e].type};
+                links.push_back(link);
+                if (!inNewRegion(rows[e].block))
+                {
+                    affected.push_back(unnumber(rows[e].block));
+                }
+            }
+        }
+    }
+    std::stable_sort(links.begin(), links.end(), [](const Link &a, const Link &b) { return a.to < b.to; });
+    std::sort(affected.begin(), affected.end());
+    affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+
+    // Predecessor rows to replace: the regions, whose edges are all new,
+    // and the blocks that gain or lose one, which keep the edges from
+    // blocks that were not replaced. Rows are ordered by source block
+    std::vector<Piece> predecessorPieces;
+    std::vector<uint32_t> predecessorLengths;
+    std::vector<Edge> predecessorRows;
+    for (size_t r = 0, a = 0; r < regionPieces.size() || a < affected.size();)
+    {
+        Piece piece;
+        size_t first;
+        bool kept = false;
+        if (a == affected.size() || (r < regionPieces.size() && regionPieces[r].begin < affected[a]))
+        {
+            piece = regionPieces[r];
+            first = piece.begin + shifts[r];
+            ++r;
+        }
+        else
+        {
+            piece.begin = affected[a];
+            piece.end = affected[a] + 1;
+            piece.count = 1;
+            first = renumber(affected[a]);
+            kept = true;
+            ++a;
+        }
+        predecessorPieces.push_back(piece);
+
+        for (size_t block = first; block < first + piece.count; ++block)
+        {
+            size_t before = predecessorRows.size();
+            auto link = std::lower_bound(links.begin(), links.end(), block,
+                                         [](const Link &l, size_t to) { return l.to < to; });
+            uint32_t e = kept ? predecessorOffsets_[piece.begin] : 0;
+            uint32_t end = kept ? predecessorOffsets_[piece.end] : 0;
+            for (;;)
+            {
+                // Skip edges from blocks whose rows were replaced
+                while (e < end && (inOldRegion(predecessors_[e].block) ||
+                                   std::binary_search(changed.begin(), changed.end(), predecessors_[e].block)))
+                {
+                    ++e;
+                }
+                bool fromLink = link != links.end() && link->to == block;
+                if (e == end && !fromLink)
+                {
+                    break;
+                }
+
+                Edge edge = Edge();
+                if (e < end && (!fromLink || renumber(predecessors_[e].block) < link->from))
+                {
+                    edge.block = renumber(predecessors_[e].block);
+                    edge.type = predecessors_[e++].type;
+                }
+                else
+                {
+                    edge.block = link->from;
+                    edge.type = (link++)->type;
+                }
+                predecessorRows.push_back(edge);
+            }
+            predecessorLengths.push_back(static_cast<uint32_t>(predecessorRows.size() - before));
+        }
+    }
+
+    // Kept edges lead to and come from renumbered blocks
+    if (std::any_of(shifts.begin(), shifts.end(), [](int64_t shift) { return shift != 0; }))
+    {
+        uint32_t first = static_cast<uint32_t>(regionPieces.front().begin);
+        for (Edge &edge : successors_)
+        {
+            if (edge.block >= first)
+            {
+                edge.block = renumber(edge.block);
+            }
+        }
+        for (Edge &edge : predecessors_)
+        {
+            if (edge.block >= first)
+            {
+                edge.block = renumber(edge.block);
+            }
+        }
+    }
+    replaceRows(successorOffsets_, successors_, pieces, lengths, rows);
+    replaceRows(predecessorOffsets_, predecessors_, predecessorPieces, predecessorLengths, predecessorRows);
+}
+
+void ControlFlowGraph::addSuccessors(size_t block, std::vector<Edge> &edges) const
+{
+    const InstructionStore &instructions = *instructions_;
+    size_t last = blockEnd(block) - 1;
+    uint8_t branchTypes = instructions.branchTypes(last);
+
+    uint64_t target;
+    if (branchesLocally(branchTypes) && instructions.target(last, target))
+    {
+        size_t index = instructions.find(target);
+        if (index != InstructionStore::npos && instructions.address(index) == target)
+        {
+            Edge edge = Edge();
+            edge.block = static_cast<uint32_t>(blockOfInstruction(index));
+            edge.type = (branchTypes & InstructionInfo::BRANCH_ALWAYS) ? EDGE_JUMP : EDGE_TAKEN;
+            edges.push_back(edge);
+        }
+    }
+
+    if (fallsThrough(branchTypes) && block + 1 < blockCount() &&
+        instructions.address(last) + instructions.length(last) == instructions.address(last + 1))
+    {
+        Edge edge = Edge();
+        edge.block = static_cast<uint32_t>(block + 1);
+        edge.type = EDGE_FALLTHROUGH;
+        edges.push_back(edge);
+    }
+}
+
+void ControlFlowGraph::linkPredecessors()
+{
+    // Predecessors are the transpose: count, prefix sum, then scatter
+    size_t blocks = blockCount();
+    predecessorOffsets_.assign(blocks + 1, 0);
+    for (const Edge &edge : successors_)
+    {
+        ++predecessorOffsets_[edge.block + 1];
+    }
+    for (size_t block = 0; block < blocks; ++block)
+    {
+        predecessorOffsets_[block + 1] += predecessorOffsets_[block];
+    }
+
+    predecessors_.resize(successors_.size());
+    std::vector<uint32_t> cursor(predecessorOffsets_.begin(), predecessorOffsets_.end() - 1);
+    for (size_t block = 0; block < blocks; ++block)
+    {
+        for (uint32_t e = successorOffsets_[block]; e < successorOffsets_[block + 1]; ++e)
+        {
+            Edge edge = Edge();
+            edge.block = static_cast<uint32_t>(block);
+            edge.type = successors_[e].type;
+            predecessors_[cursor[successors_[e].block]++] = edge;
+        }
+    }
+}
+
+size_t ControlFlowGraph::blockOfInstruction(size_t index) const
+{
+    auto it = std::upper_bound(blockStarts_.begin(), blockStarts_.end() - 1, static_cast<uint32_t>(index));
+    return (it - blockStarts_.begin()) - 1;
+}
+
+size_t ControlFlowGraph::blockAt(uint64_t address) const
+{
+    if (instructions_ == nullptr || blockCount() == 0)
+    {
+        return npos;
+    }
+
+    size_t index = instructions_->find(address);
+    if (index == InstructionStore::npos)
+    {
+        return npos;
+    }
+    return blockOfInstruction(index);
+}
+
+size_t ControlFlowGraph::memoryUsage() const
+{
+    return (blockStarts_.capacity() + successorOffsets_.capacity() + predecessorOffsets_.capacity()) * sizeof(uint32_t) +
+           (successors_.capacity() + predecessors_.capacity()) * sizeof(Edge);
+}
+
+void ControlFlowGraph::save(ProjectDatabaseWriter &writer) const
+{
+    writer.add(ProjectDatabase::TABLE_BLOCK_STARTS, blockStarts_);
+    writer.add(ProjectDatabase::TABLE_SUCCESSOR_OFFSETS, successorOffsets_);
+    writer.add(ProjectDatabase::TABLE_SUCCESSORS, successors_);
+    writer.add(ProjectDatabase::TABLE_PREDECESSOR_OFFSETS, predecessorOffsets_);
+    writer.add(ProjectDatabase::TABLE_PREDECESSORS, predecessors_);
+}
+
+// Checks that offsets delimit edges for blockCount blocks and that every
+// edge leads to one of them
+static bool validEdges(const std::vector<uint32_t> &offsets,
+                       const std::vector<ControlFlowGraph::Edge> &edges,
+                       size_t blockCount)
+{
+    if (blockCount == 0)
+    {
+        return offsets.empty() && edges.empty();
+    }
+    if (offsets.size() != blockCount + 1 || offsets.front() != 0 ||
+        offsets.back() != edges.size() ||
+        !std::is_sorted(offsets.begin(), offsets.end()))
+    {
+        return false;
+    }
+    for (const ControlFlowGraph::Edge &edge : edges)
+    {
+        if (edge.block >= blockCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ControlFlowGraph::load(const ProjectDatabase &database,
+                            const InstructionStore &instructions)
+{
+    clear();
+    bool ok =
+        database.read(ProjectDatabase::TABLE_BLOCK_STARTS, blockStarts_) &&
+        database.read(ProjectDatabase::TABLE_SUCCESSOR_OFFSETS,
+                      successorOffsets_) &&
+        database.read(ProjectDatabase::TABLE_SUCCESSORS, successors_) &&
+        database.read(ProjectDatabase::TABLE_PREDECESSOR_OFFSETS,
+                      predecessorOffsets_) &&
+        database.read(ProjectDatabase::TABLE_PREDECESSORS, predecessors_);
+
+    // Blocks cover the instructions in order
+    ok = ok && (blockStarts_.empty() ||
+                (blockStarts_.size() >= 2 && blockStarts_.front() == 0 &&
+                 blockStarts_.back() == instructions.size() &&
+                 std::is_sorted(blockStarts_.begin(), blockStarts_.end())));
+    ok = ok && validEdges(successorOffsets_, successors_, blockCount()) &&
+         validEdges(predecessorOffsets_, predecessors_, blockCount());
+    if (!ok)
+    {
+        clear();
+        return false;
+    }
+
+    instructions_ = &instructions;
+    return true;
+}
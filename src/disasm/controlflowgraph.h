@@ -0,0 +1,174 @@
+#ifndef CONTROLFLOWGRAPH_H
+#define CONTROLFLOWGRAPH_H
+#include "instructionstore.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class XrefDatabase;
+
+/* Basic blocks over an InstructionStore. A block starts at the first
+ * instruction, at each branch target, after each block-ending branch and
+ * after each gap between instructions. Calls do not end blocks.
+ *
+ * Blocks are ranges of instruction indices. Successor and predecessor
+ * edges are kept in compressed sparse row form: the edges of block b are
+ * [offsets[b], offsets[b + 1]) of one flat array, so the whole graph is a
+ * handful of arrays regardless of its shape.
+ *
+ * After an edit to the store only the blocks around the changed
+ * instructions are split again; see affectedRegions() and update(). */
+class ControlFlowGraph
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    enum EdgeType
+    {
+        EDGE_FALLTHROUGH, // into the next instruction
+        EDGE_JUMP, // unconditional branch
+        EDGE_TAKEN, // conditional branch taken
+    };
+
+    /* Saved byte for byte, so create edges value-initialized: the
+     * padding is a member and comes out zeroed rather than holding
+     * whatever was on the heap */
+    struct Edge
+    {
+        uint32_t block;
+        uint8_t type;
+        uint8_t padding[3];
+    };
+
+    /* Consecutive blocks [firstBlock, endBlock) of a graph and the
+     * addresses they span, [begin, end). end is UINT64_MAX for regions
+     * reaching past the last block */
+    struct Region
+    {
+        uint64_t begin;
+        uint64_t end;
+        size_t firstBlock;
+        size_t endBlock;
+    };
+
+    ControlFlowGraph();
+
+    void clear();
+
+    /* Splits instructions into blocks and links them. The store must not
+     * change while the graph is in use. Stops and returns false with the
+     * graph cleared once cancel, if given, is set */
+    bool build(const InstructionStore &instructions,
+               const std::atomic<bool> *cancel = nullptr);
+
+    /* Points a built graph at another store holding the same
+     * instructions, e.g. after the one it was built from was moved */
+    inline void rebind(const InstructionStore &instructions)
+    {
+        if (instructions_ != nullptr)
+        {
+            instructions_ = &instructions;
+        }
+    }
+
+    /* Returns the regions whose blocks can change when instructions in
+     * the address ranges are removed, added or become branch targets: the
+     * blocks overlapping each range and those on either side of it,
+     * sorted and merged. Call before the store changes. Empty if the
+     * graph is not built */
+    std::vector<Region> affectedRegions(
+        const std::vector<std::pair<uint64_t, uint64_t>> &ranges) const;
+
+    /* Follows an edit of the store the graph was built over. Blocks
+     * outside regions, which must come from affectedRegions() before the
+     * edit, keep their bounds and edges and are only renumbered; the ones
+     * inside are split again. xrefs must already hold the references of
+     * the edited store, since they tell which instructions are branched
+     * to. Does nothing if the graph is not built */
+    void update(const InstructionStore::Splice &splice,
+                const std::vector<Region> &regions, const XrefDatabase &xrefs);
+
+    inline size_t blockCount() const
+    {
+        return blockStarts_.empty() ? 0 : blockStarts_.size() - 1;
+    }
+
+    // Returns the index of the first instruction of a block
+    inline size_t blockFirst(size_t block) const
+    {
+        return blockStarts_[block];
+    }
+
+    // Returns one past the index of the last instruction of a block
+    inline size_t blockEnd(size_t block) const
+    {
+        return blockStarts_[block + 1];
+    }
+
+    // Returns the block containing an instruction index
+    size_t blockOfInstruction(size_t index) const;
+
+    // Returns the block containing address, or npos
+    size_t blockAt(uint64_t address) const;
+
+    inline size_t successorCount(size_t block) const
+    {
+        return successorOffsets_[block + 1] - successorOffsets_[block];
+    }
+
+    inline const Edge &successor(size_t block, size_t i) const
+    {
+        return successors_[successorOffsets_[block] + i];
+    }
+
+    inline size_t predecessorCount(size_t block) const
+    {
+        return predecessorOffsets_[block + 1] - predecessorOffsets_[block];
+    }
+
+    // The edge's block is the predecessor
+    inline const Edge &predecessor(size_t block, size_t i) const
+    {
+        return predecessors_[predecessorOffsets_[block] + i];
+    }
+
+    inline size_t edgeCount() const
+    {
+        return successors_.size();
+    }
+
+    // Returns the number of bytes used by the graph
+    size_t memoryUsage() const;
+
+    /* Adds the graph to a database. The tables are referenced, not
+     * copied, so the graph must not change before it is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the graph with the one in database, which must have been
+     * built over instructions. Returns false and leaves the graph empty
+     * if it is missing or inconsistent */
+    bool load(const ProjectDatabase &database,
+              const InstructionStore &instructions);
+
+private:
+    // Appends the successors of a block whose bounds are final
+    void addSuccessors(size_t block, std::vector<Edge> &edges) const;
+
+    // Builds the predecessor rows from the successor rows
+    void linkPredecessors();
+
+    const InstructionStore *instructions_;
+
+    // Index of the first instruction of each block, plus the instruction
+    // count at the end
+    std::vector<uint32_t> blockStarts_;
+
+    std::vector<uint32_t> successorOffsets_;
+    std::vector<Edge> successors_;
+    std::vector<uint32_t> predecessorOffsets_;
+    std::vector<Edge> predecessors_;
+};
+
+#endif // CONTROLFLOWGRAPH_H
@@ -0,0 +1,16 @@
+#ifndef DECODEDINSTRUCTION_H
+#define DECODEDINSTRUCTION_H
+#include <cstdint>
+
+/* A single decoded instruction as produced by the disassembly passes
+ * before it is added to an InstructionStore */
+struct DecodedInstruction
+{
+    uint64_t address;
+    uint64_t target; // valid when InstructionInfo::hasTarget(branchTypes)
+    uint64_t dataReference; // address of a memory operand, or zero
+    uint8_t length;
+    uint8_t branchTypes;
+};
+
+#endif // DECODEDINSTRUCTION_H
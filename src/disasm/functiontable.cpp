@@ -0,0 +1,186 @@
+#include "functiontable.h"
+#include "projectdatabase.h"
+#include <algorithm>
+
+FunctionTable::FunctionTable()
+{
+}
+
+void FunctionTable::clear()
+{
+    candidates_.clear();
+    starts_.clear();
+    ends_.clear();
+    sources_.clear();
+}
+
+void FunctionTable::add(uint64_t start, uint64_t end, uint8_t sources)
+{
+    Candidate candidate;
+    candidate.start = start;
+    candidate.end = end > start ? end : 0;
+    candidate.sources = sources;
+    candidates_.push_back(candidate);
+}
+
+void FunctionTable::finalize(const std::vector<uint64_t> &regionEnds)
+{
+    std::sort(candidates_.begin(), candidates_.end(), [](const Candidate &a, const Candidate &b) {
+        return a.start < b.start;
+    });
+
+    starts_.clear();
+    ends_.clear();
+    sources_.clear();
+    starts_.reserve(candidates_.size());
+    ends_.reserve(candidates_.size());
+    sources_.reserve(candidates_.size());
+
+    // End of the last function with exact bounds
+    uint64_t exactEnd = 0;
+    for (const Candidate &candidate : candidates_)
+    {
+        if (!starts_.empty() && starts_.back() == candidate.start)
+        {
+            sources_.back() |= candidate.sources;
+            ends_.back() = std::max(ends_.back(), candidate.end);
+        }
+        else
+        {
+            if (candidate.start < exactEnd && !(candidate.sources & SOURCE_EXCEPTION))
+            {
+                continue;
+            }
+            starts_.push_back(candidate.start);
+            ends_.push_back(candidate.end);
+            sources_.push_back(candidate.sources);
+        }
+
+        if (candidate.sources & SOURCE_EXCEPTION)
+        {
+            exactEnd = std::max(exactEnd, candidate.end);
+        }
+    }
+
+    candidates_.clear();
+    candidates_.shrink_to_fit();
+
+    for (size_t i = 0; i < starts_.size(); ++i)
+    {
+        if (ends_[i] == 0)
+        {
+            ends_[i] = derivedEnd(starts_[i], i + 1 < starts_.size() ? starts_[i + 1] : 0, regionEnds);
+        }
+    }
+}
+
+size_t FunctionTable::insert(uint64_t start, uint64_t end, uint8_t sources, const std::vector<uint64_t> &regionEnds)
+{
+    size_t index = lowerBound(start);
+    if (index < starts_.size() && starts_[index] == start)
+    {
+        sources_[index] |= sources;
+        if (end > start)
+        {
+            ends_[index] = end;
+        }
+        return index;
+    }
+
+    // As in finalize(), nothing else starts inside exact bounds
+    if (index > 0 && (sources_[index - 1] & SOURCE_EXCEPTION) && start < ends_[index - 1] &&
+        !(sources & (SOURCE_EXCEPTION | SOURCE_USER)))
+    {
+        return npos;
+    }
+
+    uint64_t next = index < starts_.size() ? starts_[index] : 0;
+    if (index > 0 && endDerived(index - 1, next, regionEnds))
+    {
+        ends_[index - 1] = derivedEnd(starts_[index - 1], start, regionEnds);
+    }
+
+    starts_.insert(starts_.begin() + index, start);
+    ends_.insert(ends_.begin() + index, end > start ? end : derivedEnd(start, next, regionEnds));
+    sources_.insert(sources_.begin() + index, sources);
+    return index;
+}
+
+void FunctionTable::removeSources(size_t index, uint8_t sources, const std::vector<uint64_t> &regionEnds)
+{
+    sources_[index] &= ~sources;
+    if (sources_[index] != 0)
+    {
+        return;
+    }
+
+    uint64_t next = index + 1 < starts_.size() ? starts_[index + 1] : 0;
+    if (index > 0 && endDerived(index - 1, starts_[index], regionEnds))
+    {
+        ends_[index - 1] = derivedEnd(starts_[index - 1], next, regionEnds);
+    }
+
+    starts_.erase(starts_.begin() + index);
+    ends_.erase(ends_.begin() + index);
+    sources_.erase(sources_.begin() + index);
+}
+
+uint64_t FunctionTable::derivedEnd(uint64_t start, uint64_t next, const std::vector<uint64_t> &regionEnds)
+{
+    auto region = std::upper_bound(regionEnds.begin(), regionEnds.end(), start);
+    uint64_t end = region != regionEnds.end() ? *region : start + 1;
+    if (next != 0)
+    {
+        end = std::min(end, next);
+    }
+    return end;
+}
+
+bool FunctionTable::endDerived(size_t index, uint64_t next, const std::vector<uint64_t> &regionEnds) const
+{
+    return !(sources_[index] & SOURCE_EXCEPTION) && ends_[index] == derivedEnd(starts_[index], next, regionEnds);
+}
+
+size_t FunctionTable::find(uint64_t address) const
+{
+    size_t index = std::upper_bound(starts_.begin(), starts_.end(), address) - starts_.begin();
+    if (index == 0)
+    {
+        return npos;
+    }
+    --index;
+
+    if (address >= ends_[index])
+    {
+        return npos;
+    }
+    return index;
+}
+
+size_t FunctionTable::lowerBound(uint64_t address) const
+{
+    return std::lower_bound(starts_.begin(), starts_.end(), address) - starts_.begin();
+}
+
+void FunctionTable::save(ProjectDatabaseWriter &writer) const
+{
+    writer.add(ProjectDatabase::TABLE_FUNCTION_STARTS, starts_);
+    writer.add(ProjectDatabase::TABLE_FUNCTION_ENDS, ends_);
+    writer.add(ProjectDatabase::TABLE_FUNCTION_SOURCES, sources_);
+}
+
+bool FunctionTable::load(const ProjectDatabase &database)
+{
+    clear();
+    bool ok =
+        database.read(ProjectDatabase::TABLE_FUNCTION_STARTS, starts_) &&
+        database.read(ProjectDatabase::TABLE_FUNCTION_ENDS, ends_) &&
+        database.read(ProjectDatabase::TABLE_FUNCTION_SOURCES, sources_) &&
+        ends_.size() == starts_.size() && sources_.size() == starts_.size() &&
+        std::is_sorted(starts_.begin(), starts_.end());
+    if (!ok)
+    {
+        clear();
+    }
+    return ok;
+}
@@ -0,0 +1,122 @@
+#ifndef FUNCTIONTABLE_H
+#define FUNCTIONTABLE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ProjectDatabase;
+class ProjectDatabaseWriter;
+
+/* Function start and end addresses sorted by start. Candidates from any
+ * number of sources are added, then finalize() merges them into the table
+ * that lookups run against. The finalized table can then be edited one
+ * function at a time. */
+class FunctionTable
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    // Where a function was found. A function may have several
+    enum Source
+    {
+        SOURCE_EXCEPTION = 1, // exception directory; exact bounds
+        SOURCE_EXPORT = 2,
+        SOURCE_ENTRY = 4,
+        SOURCE_CALL = 8, // target of a direct call
+        SOURCE_PROLOGUE = 16, // matched a prologue signature
+        SOURCE_USER = 32, // defined by the user
+    };
+
+    FunctionTable();
+
+    void clear();
+
+    /* Adds a candidate function. end is zero when it is not known.
+     * Candidates may repeat */
+    void add(uint64_t start, uint64_t end, uint8_t sources);
+
+    /* Sorts and merges the candidates into the table. Candidates that start
+     * inside a function from the exception directory are dropped, as its
+     * bounds are exact. Unknown ends are set to the next function start,
+     * capped at the first of regionEnds (sorted) past the start */
+    void finalize(const std::vector<uint64_t> &regionEnds);
+
+    /* Adds a function to the finalized table, or adds sources to the one
+     * at start. An unknown end runs to the next function as in
+     * finalize(), and the function before is cut short at start unless
+     * its end is exact. Returns the index of the function, or npos if it
+     * starts inside one from the exception directory and is not from the
+     * user */
+    size_t insert(uint64_t start, uint64_t end, uint8_t sources,
+                  const std::vector<uint64_t> &regionEnds);
+
+    /* Takes sources from the function at index and removes it once it has
+     * none left. The function before then runs on over it unless its end
+     * is exact */
+    void removeSources(size_t index, uint8_t sources,
+                       const std::vector<uint64_t> &regionEnds);
+
+    inline size_t size() const
+    {
+        return starts_.size();
+    }
+
+    inline uint64_t start(size_t index) const
+    {
+        return starts_[index];
+    }
+
+    inline uint64_t end(size_t index) const
+    {
+        return ends_[index];
+    }
+
+    // Returns the Source flags of a function
+    inline uint8_t sources(size_t index) const
+    {
+        return sources_[index];
+    }
+
+    /* Returns the index of the function containing address, or npos. Where
+     * functions overlap the one starting last wins */
+    size_t find(uint64_t address) const;
+
+    // Returns the index of the first function starting at or after address
+    size_t lowerBound(uint64_t address) const;
+
+    /* Adds the finalized table to a database. The tables are referenced,
+     * not copied, so it must not change before the database is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the table with the finalized one in database. Returns
+     * false and leaves the table empty if it is missing or inconsistent */
+    bool load(const ProjectDatabase &database);
+
+private:
+    /* Returns where a function starting at start ends when its end is not
+     * known: at next, the start of the following function (zero if none),
+     * or at the first region end past start */
+    static uint64_t derivedEnd(uint64_t start, uint64_t next,
+                               const std::vector<uint64_t> &regionEnds);
+
+    /* Returns true if the end of the function at index was derived, given
+     * the start of the function after it when the table was last changed
+     * (zero if none) */
+    bool endDerived(size_t index, uint64_t next,
+                    const std::vector<uint64_t> &regionEnds) const;
+
+    struct Candidate
+    {
+        uint64_t start;
+        uint64_t end;
+        uint8_t sources;
+    };
+
+    std::vector<Candidate> candidates_;
+
+    std::vector<uint64_t> starts_;
+    std::vector<uint64_t> ends_;
+    std::vector<uint8_t> sources_;
+};
+
+#endif // FUNCTIONTABLE_H
@@ -1,6 +1,6 @@
 #include "instructioninfo.h"
 
-InstructionInfo::InstructionInfo()
+InstructionInfo::InstructionInfo() : length_(0), branchTypes_(0), branches_{0, 0}, dataReference_(0)
 {
 
 }
@@ -10,16 +10,13 @@ void InstructionInfo::setBranch(InstructionInfo::BranchType branch, uint64_t loc
 {
     branchTypes_ |= branch;
     
-    switch (branch)
+    // The register and indirect flags may be combined with the branch type
+    if (branch & (BRANCH_ALWAYS | BRANCH_TAKEN))
     {
-        case BRANCH_ALWAYS:
-        case BRANCH_TAKEN:
-            branches_[0] = location;
-            break;
-        case BRANCH_NOTTAKEN:
-            branches_[1] = location;
-            break;
-        default:
-            break;
+        branches_[0] = location;
+    }
+    else if (branch & BRANCH_NOTTAKEN)
+    {
+        branches_[1] = location;
     }
 }
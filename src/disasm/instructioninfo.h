@@ -26,12 +26,47 @@ public:
         BRANCH_ALWAYS_REG = 16, // the branch location is a register
         BRANCH_TAKEN_REG = 16,
         BRANCH_NOTTAKEN_REG = 32,
+        BRANCH_CALL = 64, // the branch is a call; execution continues after it
+        BRANCH_INDIRECT = 128, // the branch location is read from memory at the target
     };
     
     
     // Adds branch info
     void setBranch(BranchType branch, uint64_t location);
     
+    inline uint8_t branchTypes()
+    {
+        return branchTypes_;
+    }
+    
+    // Returns the branch location. Index 0 is the taken (or always) branch,
+    // index 1 the branch not taken
+    inline uint64_t branch(int index)
+    {
+        return branches_[index];
+    }
+    
+    // Returns true if branchTypes has a taken or always branch to a known
+    // address (or, with BRANCH_INDIRECT, to a known memory slot)
+    static inline bool hasTarget(uint8_t branchTypes)
+    {
+        return (branchTypes & (BRANCH_TAKEN | BRANCH_ALWAYS)) != 0 &&
+               (branchTypes & BRANCH_TAKEN_REG) == 0;
+    }
+    
+    /* Sets the address of a memory operand whose location is known without
+     * executing, e.g. a RIP-relative or absolute operand */
+    inline void setDataReference(uint64_t address)
+    {
+        dataReference_ = address;
+    }
+    
+    // Returns the address of the memory operand, or zero if there is none
+    inline uint64_t dataReference()
+    {
+        return dataReference_;
+    }
+    
 private:
     uint32_t length_;
     uint8_t branchTypes_;
@@ -40,6 +75,8 @@ private:
     // branch that is taken while branch[1] is the branch not taken. If BRANCH_ALWAYS,
     // branches[0] is the branch location
     uint64_t branches_[2];
+    
+    uint64_t dataReference_;
 };
 
 #endif // INSTRUCTIONINFO_H
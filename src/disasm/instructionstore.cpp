@@ -0,0 +1,327 @@
+#include "instructionstore.h"
+#include "instructioninfo.h"
+#include "projectdatabase.h"
+#include <algorithm>
+
+InstructionStore::InstructionStore() : base_(0)
+{
+}
+
+void InstructionStore::clear(uint64_t base)
+{
+    base_ = base;
+    offsets_.clear();
+    lengths_.clear();
+    branchTypes_.clear();
+    targetIndices_.clear();
+    targets_.clear();
+    dataIndices_.clear();
+    dataReferences_.clear();
+}
+
+void InstructionStore::reserve(size_t count)
+{
+    offsets_.reserve(count);
+    lengths_.reserve(count);
+    branchTypes_.reserve(count);
+}
+
+void InstructionStore::append(uint64_t address, uint8_t length,
+                              uint8_t branchTypes, uint64_t target,
+                              uint64_t dataReference)
+{
+    if (dataReference != 0)
+    {
+        dataIndices_.push_back(static_cast<uint32_t>(offsets_.size()));
+        dataReferences_.push_back(dataReference);
+    }
+
+    if (InstructionInfo::hasTarget(branchTypes))
+    {
+        targetIndices_.push_back(static_cast<uint32_t>(offsets_.size()));
+        targets_.push_back(target);
+    }
+
+    offsets_.push_back(static_cast<uint32_t>(address - base_));
+    lengths_.push_back(length);
+    branchTypes_.push_back(branchTypes);
+}
+
+bool InstructionStore::target(size_t index, uint64_t &target) const
+{
+    if (!InstructionInfo::hasTarget(branchTypes_[index]))
+    {
+        return false;
+    }
+
+    auto it = std::lower_bound(targetIndices_.begin(), targetIndices_.end(),
+                               static_cast<uint32_t>(index));
+    if (it == targetIndices_.end() || *it != index)
+    {
+        return false;
+    }
+
+    target = targets_[it - targetIndices_.begin()];
+    return true;
+}
+
+bool InstructionStore::dataReference(size_t index, uint64_t &address) const
+{
+    auto it = std::lower_bound(dataIndices_.begin(), dataIndices_.end(),
+                               static_cast<uint32_t>(index));
+    if (it == dataIndices_.end() || *it != index)
+    {
+        return false;
+    }
+
+    address = dataReferences_[it - dataIndices_.begin()];
+    return true;
+}
+
+size_t InstructionStore::Splice::map(size_t index) const
+{
+    if (index >= first && index < last)
+    {
+        return npos;
+    }
+
+    size_t remaining = index < first ? index : index - (last - first);
+    return remaining + (std::upper_bound(positions.begin(), positions.end(),
+                                         remaining) -
+                        positions.begin());
+}
+
+// Removes values [first, last) and inserts added[j] before the remaining
+// value positions[j]. The tail moves in place, run by run, as in a merge
+// from the back
+template <typename T>
+static void spliceDense(std::vector<T> &values, size_t first, size_t last,
+                        const std::vector<size_t> &positions, const T *added)
+{
+    values.erase(values.begin() + first, values.begin() + last);
+
+    size_t end = values.size();
+    values.resize(end + positions.size());
+    for (size_t j = positions.size(); j-- > 0;)
+    {
+        std::move_backward(values.begin() + positions[j], values.begin() + end,
+                           values.begin() + end + j + 1);
+        values[positions[j] + j] = added[j];
+        end = positions[j];
+    }
+}
+
+// The same for a sparse side table, whose indices are renumbered on the
+// way. Entries before the first change are left alone
+template <typename T>
+static void spliceSparse(std::vector<uint32_t> &indices,
+                         std::vector<T> &values,
+                         const InstructionStore::Splice &splice,
+                         const std::vector<uint32_t> &addedIndices,
+                         const std::vector<T> &addedValues)
+{
+    auto first = std::lower_bound(indices.begin(), indices.end(),
+                                  static_cast<uint32_t>(splice.first));
+    auto last = std::lower_bound(first, indices.end(),
+                                 static_cast<uint32_t>(splice.last));
+    values.erase(values.begin() + (first - indices.begin()),
+                 values.begin() + (last - indices.begin()));
+    indices.erase(first, last);
+
+    const std::vector<size_t> &positions = splice.positions;
+    size_t removed = splice.last - splice.first;
+    size_t i = indices.size();
+    size_t j = addedIndices.size();
+    size_t p = positions.size();
+    indices.resize(i + j);
+    values.resize(i + j);
+
+    // Always i + j, where the next entry goes
+    size_t out = indices.size();
+    while (i > 0)
+    {
+        size_t index = indices[i - 1];
+        if (index < splice.first && j == 0 && p == 0)
+        {
+            break;
+        }
+
+        // p is the number of added instructions before this one
+        size_t remaining = index >= splice.last ? index - removed : index;
+        while (p > 0 && positions[p - 1] > remaining)
+        {
+            --p;
+        }
+
+        size_t existing = remaining + p;
+        if (j > 0 && positions[addedIndices[j - 1]] + addedIndices[j - 1] > existing)
+        {
+            --j;
+            --out;
+            indices[out] = static_cast<uint32_t>(positions[addedIndices[j]] +
+                                                 addedIndices[j]);
+            values[out] = addedValues[j];
+            continue;
+        }
+
+        --i;
+        --out;
+        indices[out] = static_cast<uint32_t>(existing);
+        values[out] = values[i];
+    }
+    while (j > 0)
+    {
+        --j;
+        --out;
+        indices[out] =
+            static_cast<uint32_t>(positions[addedIndices[j]] + addedIndices[j]);
+        values[out] = addedValues[j];
+    }
+}
+
+InstructionStore::Splice InstructionStore::replace(
+    size_t first, size_t last, const InstructionStore &added)
+{
+    Splice splice;
+    splice.first = first;
+    splice.last = last;
+    if (first == last && added.size() == 0)
+    {
+        return splice;
+    }
+
+    size_t removed = last - first;
+    splice.positions.reserve(added.size());
+    for (size_t j = 0; j < added.size(); ++j)
+    {
+        size_t position = lowerBound(added.address(j));
+        if (position > first)
+        {
+            position = position >= last ? position - removed : first;
+        }
+        splice.positions.push_back(position);
+    }
+
+    spliceDense(offsets_, first, last, splice.positions,
+                added.offsets_.data());
+    spliceDense(lengths_, first, last, splice.positions,
+                added.lengths_.data());
+    spliceDense(branchTypes_, first, last, splice.positions,
+                added.branchTypes_.data());
+    spliceSparse(targetIndices_, targets_, splice, added.targetIndices_,
+                 added.targets_);
+    spliceSparse(dataIndices_, dataReferences_, splice, added.dataIndices_,
+                 added.dataReferences_);
+    return splice;
+}
+
+size_t InstructionStore::lowerBound(uint64_t address) const
+{
+    if (address < base_)
+    {
+        return 0;
+    }
+    if (address - base_ > UINT32_MAX)
+    {
+        return size();
+    }
+
+    uint32_t offset = static_cast<uint32_t>(address - base_);
+    return std::lower_bound(offsets_.begin(), offsets_.end(), offset) -
+           offsets_.begin();
+}
+
+size_t InstructionStore::find(uint64_t address) const
+{
+    size_t index = lowerBound(address);
+    if (index < size() && this->address(index) == address)
+    {
+        return index;
+    }
+
+    // The address may be inside the previous instruction
+    if (index == 0)
+    {
+        return npos;
+    }
+    --index;
+    if (address < this->address(index) + lengths_[index])
+    {
+        return index;
+    }
+    return npos;
+}
+
+size_t InstructionStore::memoryUsage() const
+{
+    return offsets_.capacity() * sizeof(uint32_t) + lengths_.capacity() +
+           branchTypes_.capacity() +
+           targetIndices_.capacity() * sizeof(uint32_t) +
+           targets_.capacity() * sizeof(uint64_t) +
+           dataIndices_.capacity() * sizeof(uint32_t) +
+           dataReferences_.capacity() * sizeof(uint64_t);
+}
+
+void InstructionStore::save(ProjectDatabaseWriter &writer) const
+{
+    writer.addCopy(ProjectDatabase::TABLE_IMAGE_BASE,
+                   std::vector<uint64_t>(1, base_));
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_OFFSETS, offsets_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_LENGTHS, lengths_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_BRANCH_TYPES, branchTypes_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_TARGET_INDICES,
+               targetIndices_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_TARGETS, targets_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_DATA_INDICES, dataIndices_);
+    writer.add(ProjectDatabase::TABLE_INSTRUCTION_DATA_REFERENCES,
+               dataReferences_);
+}
+
+// Checks that a sparse side table is sorted and indexes count instructions
+static bool validIndices(const std::vector<uint32_t> &indices,
+                         size_t valueCount, size_t count)
+{
+    if (indices.size() != valueCount)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] >= count || (i != 0 && indices[i] <= indices[i - 1]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool InstructionStore::load(const ProjectDatabase &database)
+{
+    ProjectDatabase::Table<uint64_t> base =
+        database.table<uint64_t>(ProjectDatabase::TABLE_IMAGE_BASE);
+    clear(base.size == 1 ? base[0] : 0);
+
+    bool ok =
+        base.size == 1 &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_OFFSETS, offsets_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_LENGTHS, lengths_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_BRANCH_TYPES,
+                      branchTypes_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_TARGET_INDICES,
+                      targetIndices_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_TARGETS, targets_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_DATA_INDICES,
+                      dataIndices_) &&
+        database.read(ProjectDatabase::TABLE_INSTRUCTION_DATA_REFERENCES,
+                      dataReferences_);
+
+    ok = ok && lengths_.size() == offsets_.size() &&
+         branchTypes_.size() == offsets_.size() &&
+         validIndices(targetIndices_, targets_.size(), offsets_.size()) &&
+         validIndices(dataIndices_, dataReferences_.size(), offsets_.size());
+    if (!ok)
+    {
+        clear();
+    }
+    return ok;
+}
@@ -0,0 +1,125 @@
+#ifndef INSTRUCTIONSTORE_H
+#define INSTRUCTIONSTORE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ProjectDatabase;
+class ProjectDatabaseWriter;
+
+/* Decoded instructions in struct-of-arrays form, sorted by address.
+ * Addresses are stored as 32 bit offsets from a base address and each
+ * instruction takes 6 bytes. Branch targets and memory operand addresses
+ * are kept in sparse side tables for the instructions that have one. */
+class InstructionStore
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    /* How replace() moved the instructions, so that structures holding
+     * instruction indices can follow them */
+    struct Splice
+    {
+        // The removed range of old indices
+        size_t first;
+        size_t last;
+
+        // For each added instruction, the number of remaining old
+        // instructions before it
+        std::vector<size_t> positions;
+
+        // Returns the new index of an old instruction, or npos if it was
+        // removed
+        size_t map(size_t index) const;
+    };
+
+    InstructionStore();
+
+    /* Removes all instructions and sets the address offsets are relative
+     * to */
+    void clear(uint64_t base = 0);
+
+    void reserve(size_t count);
+
+    /* Appends an instruction. Instructions must be appended in ascending
+     * address order. target is ignored unless
+     * InstructionInfo::hasTarget(branchTypes). dataReference is the
+     * address of a memory operand, or zero */
+    void append(uint64_t address, uint8_t length, uint8_t branchTypes,
+                uint64_t target, uint64_t dataReference = 0);
+
+    inline size_t size() const
+    {
+        return offsets_.size();
+    }
+
+    inline uint64_t base() const
+    {
+        return base_;
+    }
+
+    inline uint64_t address(size_t index) const
+    {
+        return base_ + offsets_[index];
+    }
+
+    inline uint8_t length(size_t index) const
+    {
+        return lengths_[index];
+    }
+
+    // Returns the InstructionInfo::BranchType flags of an instruction
+    inline uint8_t branchTypes(size_t index) const
+    {
+        return branchTypes_[index];
+    }
+
+    /* Gets the branch target of an instruction. Returns false if it has
+     * no known target */
+    bool target(size_t index, uint64_t &target) const;
+
+    /* Gets the address of the memory operand of an instruction. Returns
+     * false if it has none */
+    bool dataReference(size_t index, uint64_t &address) const;
+
+    /* Removes instructions [first, last) and inserts the ones in added,
+     * which must have the same base and must not overlap the instructions
+     * that remain. Only the elements from the first change on move, so an
+     * edit costs a move of the tail of each array rather than a rebuild */
+    Splice replace(size_t first, size_t last, const InstructionStore &added);
+
+    /* Returns the index of the instruction starting at or containing
+     * address, or npos */
+    size_t find(uint64_t address) const;
+
+    /* Returns the index of the first instruction at or after address */
+    size_t lowerBound(uint64_t address) const;
+
+    // Returns the number of bytes used by the store
+    size_t memoryUsage() const;
+
+    /* Adds the store to a database. The tables are referenced, not copied,
+     * so it must not change before the database is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the store with the one in database. Returns false and
+     * leaves it empty if the tables are missing or inconsistent */
+    bool load(const ProjectDatabase &database);
+
+private:
+    uint64_t base_;
+
+    std::vector<uint32_t> offsets_;
+    std::vector<uint8_t> lengths_;
+    std::vector<uint8_t> branchTypes_;
+
+    // Sorted by instruction index
+    std::vector<uint32_t> targetIndices_;
+    std::vector<uint64_t> targets_;
+
+    // Sparse like the targets
+    std::vector<uint32_t> dataIndices_;
+    std::vector<uint64_t> dataReferences_;
+};
+
+#endif // INSTRUCTIONSTORE_H
@@ -0,0 +1,310 @@
+#include "xrefdatabase.h"
+#include "instructioninfo.h"
+#include "projectdatabase.h"
+#include <algorithm>
+
+namespace
+{
+inline uint64_t key(const XrefDatabase::Xref &xref, bool bySource)
+{
+    return bySource ? xref.from : xref.to;
+}
+
+inline uint64_t value(const XrefDatabase::Xref &xref, bool bySource)
+{
+    return bySource ? xref.to : xref.from;
+}
+
+// Orders references by (key, value, type)
+struct XrefLess
+{
+    bool bySource;
+
+    bool operator()(const XrefDatabase::Xref &a, const XrefDatabase::Xref &b) const
+    {
+        if (key(a, bySource) != key(b, bySource))
+        {
+            return key(a, bySource) < key(b, bySource);
+        }
+        if (value(a, bySource) != value(b, bySource))
+        {
+            return value(a, bySource) < value(b, bySource);
+        }
+        return a.type < b.type;
+    }
+};
+}
+
+XrefDatabase::XrefDatabase()
+{
+}
+
+void XrefDatabase::clear()
+{
+    byFrom_.clear();
+    byTo_.clear();
+    pending_.clear();
+}
+
+void XrefDatabase::addInstructions(const InstructionStore &instructions, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        uint8_t types = instructions.branchTypes(i);
+        uint64_t address = instructions.address(i);
+
+        // Indirect targets are memory slots, which the data reference
+        // already covers
+        uint64_t target;
+        if ((types & InstructionInfo::BRANCH_INDIRECT) == 0 && instructions.target(i, target))
+        {
+            Xref xref;
+            xref.from = address;
+            xref.to = target;
+            if (types & InstructionInfo::BRANCH_CALL)
+            {
+                xref.type = XREF_CALL;
+            }
+            else if (types & InstructionInfo::BRANCH_ALWAYS)
+            {
+                xref.type = XREF_JUMP;
+            }
+            else
+            {
+                xref.type = XREF_BRANCH;
+            }
+            pending_.push_back(xref);
+        }
+
+        uint64_t data;
+        if (instructions.dataReference(i, data))
+        {
+            Xref xref;
+            xref.from = address;
+            xref.to = data;
+            xref.type = XREF_DATA;
+            pending_.push_back(xref);
+        }
+    }
+
+    commit();
+}
+
+void XrefDatabase::add(uint64_t from, uint64_t to, Type type)
+{
+    Xref xref;
+    xref.from = from;
+    xref.to = to;
+    xref.type = type;
+    pending_.push_back(xref);
+    commit();
+}
+
+void XrefDatabase::removeFrom(uint64_t begin, uint64_t end)
+{
+    // Sorted by source, so these are one range
+    byFrom_.erase(begin, end);
+    byTo_.removeIf([begin, end](uint64_t, uint64_t value) {
+        return value >= begin && value < end;
+    });
+}
+
+size_t XrefDatabase::referencesFrom(uint64_t address, std::vector<Xref> &xrefs) const
+{
+    xrefs.clear();
+
+    size_t begin, end;
+    byFrom_.range(address, begin, end);
+    for (size_t i = begin; i < end; ++i)
+    {
+        Xref xref;
+        xref.from = address;
+        xref.to = byFrom_.values_[i];
+        xref.type = byFrom_.types_[i];
+        xrefs.push_back(xref);
+    }
+    return xrefs.size();
+}
+
+size_t XrefDatabase::referencesTo(uint64_t address, std::vector<Xref> &xrefs) const
+{
+    xrefs.clear();
+
+    size_t begin, end;
+    byTo_.range(address, begin, end);
+    for (size_t i = begin; i < end; ++i)
+    {
+        Xref xref;
+        xref.from = byTo_.values_[i];
+        xref.to = address;
+        xref.type = byTo_.types_[i];
+        xrefs.push_back(xref);
+    }
+    return xrefs.size();
+}
+
+size_t XrefDatabase::countTo(uint64_t address) const
+{
+    size_t begin, end;
+    byTo_.range(address, begin, end);
+    return end - begin;
+}
+
+size_t XrefDatabase::memoryUsage() const
+{
+    return byFrom_.memoryUsage() + byTo_.memoryUsage();
+}
+
+void XrefDatabase::save(ProjectDatabaseWriter &writer) const
+{
+    byFrom_.save(writer, ProjectDatabase::TABLE_XREFS_FROM_KEYS);
+    byTo_.save(writer, ProjectDatabase::TABLE_XREFS_TO_KEYS);
+}
+
+bool XrefDatabase::load(const ProjectDatabase &database)
+{
+    clear();
+    bool ok = byFrom_.load(database, ProjectDatabase::TABLE_XREFS_FROM_KEYS) &&
+              byTo_.load(database, ProjectDatabase::TABLE_XREFS_TO_KEYS) &&
+              byFrom_.size() == byTo_.size();
+    if (!ok)
+    {
+        clear();
+    }
+    return ok;
+}
+
+void XrefDatabase::commit()
+{
+    if (pending_.empty())
+    {
+        return;
+    }
+
+    std::sort(pending_.begin(), pending_.end(), XrefLess{true});
+    byFrom_.merge(pending_, true);
+
+    std::sort(pending_.begin(), pending_.end(), XrefLess{false});
+    byTo_.merge(pending_, false);
+
+    pending_.clear();
+}
+
+void XrefDatabase::Index::clear()
+{
+    keys_.clear();
+    values_.clear();
+    types_.clear();
+}
+
+void XrefDatabase::Index::merge(const std::vector<Xref> &entries, bool bySource)
+{
+    std::vector<uint64_t> keys, values;
+    std::vector<uint8_t> types;
+    keys.reserve(keys_.size() + entries.size());
+    values.reserve(keys_.size() + entries.size());
+    types.reserve(keys_.size() + entries.size());
+
+    auto push = [&](uint64_t k, uint64_t v, uint8_t t) {
+        if (!keys.empty() && keys.back() == k && values.back() == v && types.back() == t)
+        {
+            return;
+        }
+        keys.push_back(k);
+        values.push_back(v);
+        types.push_back(t);
+    };
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < keys_.size() || j < entries.size())
+    {
+        bool takeExisting;
+        if (j == entries.size())
+        {
+            takeExisting = true;
+        }
+        else if (i == keys_.size())
+        {
+            takeExisting = false;
+        }
+        else
+        {
+            const Xref &entry = entries[j];
+            uint64_t k = key(entry, bySource);
+            uint64_t v = value(entry, bySource);
+            takeExisting = keys_[i] < k || (keys_[i] == k && (values_[i] < v || (values_[i] == v && types_[i] <= entry.type)));
+        }
+
+        if (takeExisting)
+        {
+            push(keys_[i], values_[i], types_[i]);
+            ++i;
+        }
+        else
+        {
+            push(key(entries[j], bySource), value(entries[j], bySource), entries[j].type);
+            ++j;
+        }
+    }
+
+    keys_.swap(keys);
+    values_.swap(values);
+    types_.swap(types);
+}
+
+void XrefDatabase::Index::range(uint64_t key, size_t &begin, size_t &end) const
+{
+    auto range = std::equal_range(keys_.begin(), keys_.end(), key);
+    begin = range.first - keys_.begin();
+    end = range.second - keys_.begin();
+}
+
+void XrefDatabase::Index::erase(uint64_t begin, uint64_t end)
+{
+    size_t first = std::lower_bound(keys_.begin(), keys_.end(), begin) - keys_.begin();
+    size_t last = std::lower_bound(keys_.begin() + first, keys_.end(), end) - keys_.begin();
+    keys_.erase(keys_.begin() + first, keys_.begin() + last);
+    values_.erase(values_.begin() + first, values_.begin() + last);
+    types_.erase(types_.begin() + first, types_.begin() + last);
+}
+
+template <typename Predicate> void XrefDatabase::Index::removeIf(Predicate remove)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < keys_.size(); ++i)
+    {
+        if (remove(keys_[i], values_[i]))
+        {
+            continue;
+        }
+        keys_[kept] = keys_[i];
+        values_[kept] = values_[i];
+        types_[kept] = types_[i];
+        ++kept;
+    }
+    keys_.resize(kept);
+    values_.resize(kept);
+    types_.resize(kept);
+}
+
+size_t XrefDatabase::Index::memoryUsage() const
+{
+    return (keys_.capacity() + values_.capacity()) * sizeof(uint64_t) + types_.capacity();
+}
+
+void XrefDatabase::Index::save(ProjectDatabaseWriter &writer, int first) const
+{
+    writer.add(static_cast<ProjectDatabase::TableId>(first), keys_);
+    writer.add(static_cast<ProjectDatabase::TableId>(first + 1), values_);
+    writer.add(static_cast<ProjectDatabase::TableId>(first + 2), types_);
+}
+
+bool XrefDatabase::Index::load(const ProjectDatabase &database, int first)
+{
+    return database.read(static_cast<ProjectDatabase::TableId>(first), keys_) &&
+           database.read(static_cast<ProjectDatabase::TableId>(first + 1), values_) &&
+           database.read(static_cast<ProjectDatabase::TableId>(first + 2), types_) &&
+           values_.size() == keys_.size() && types_.size() == keys_.size() &&
+           std::is_sorted(keys_.begin(), keys_.end());
+}
@@ -0,0 +1,118 @@
+#ifndef XREFDATABASE_H
+#define XREFDATABASE_H
+#include "instructionstore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Cross references between instructions and the addresses they branch to
+ * or access. Each reference is kept twice, sorted by source and sorted by
+ * destination, in flat arrays, so both directions are a binary search.
+ * References are added a region at a time and merged in, so decoding more
+ * code does not rebuild the database. */
+class XrefDatabase
+{
+public:
+    enum Type
+    {
+        XREF_CALL,
+        XREF_JUMP, // unconditional branch
+        XREF_BRANCH, // conditional branch
+        XREF_DATA, // memory operand
+    };
+
+    struct Xref
+    {
+        uint64_t from;
+        uint64_t to;
+        uint8_t type;
+    };
+
+    XrefDatabase();
+
+    void clear();
+
+    /* Adds the references made by instructions [first, last) of a store.
+     * References that are already present are not duplicated */
+    void addInstructions(const InstructionStore &instructions, size_t first,
+                         size_t last);
+
+    // Adds a single reference
+    void add(uint64_t from, uint64_t to, Type type);
+
+    // Removes the references made by instructions in [begin, end)
+    void removeFrom(uint64_t begin, uint64_t end);
+
+    inline size_t size() const
+    {
+        return byFrom_.size();
+    }
+
+    /* Gets the references made by the instruction at address, sorted by
+     * destination. Returns their number */
+    size_t referencesFrom(uint64_t address, std::vector<Xref> &xrefs) const;
+
+    /* Gets the references to address, sorted by source. Returns their
+     * number */
+    size_t referencesTo(uint64_t address, std::vector<Xref> &xrefs) const;
+
+    // Returns the number of references to address
+    size_t countTo(uint64_t address) const;
+
+    // Returns the number of bytes used by the database
+    size_t memoryUsage() const;
+
+    /* Adds both indices to a database. The tables are referenced, not
+     * copied, so the database must not change before it is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the references with the ones in database. Returns false
+     * and leaves none if they are missing or inconsistent */
+    bool load(const ProjectDatabase &database);
+
+private:
+    /* References in struct-of-arrays form sorted by (key, value, type).
+     * key is the source in one direction and the destination in the
+     * other */
+    class Index
+    {
+    public:
+        inline size_t size() const
+        {
+            return keys_.size();
+        }
+
+        void clear();
+
+        // Merges entries sorted by (key, value, type), dropping duplicates
+        void merge(const std::vector<Xref> &entries, bool bySource);
+
+        // Returns the range of entries with key
+        void range(uint64_t key, size_t &begin, size_t &end) const;
+
+        // Removes the entries with keys in [begin, end)
+        void erase(uint64_t begin, uint64_t end);
+
+        // Removes the entries matching remove(key, value)
+        template <typename Predicate> void removeIf(Predicate remove);
+
+        size_t memoryUsage() const;
+
+        // The tables are saved under ids first, first + 1 and first + 2
+        void save(ProjectDatabaseWriter &writer, int first) const;
+        bool load(const ProjectDatabase &database, int first);
+
+        std::vector<uint64_t> keys_;
+        std::vector<uint64_t> values_;
+        std::vector<uint8_t> types_;
+    };
+
+    // Merges pending_ into both indices
+    void commit();
+
+    Index byFrom_;
+    Index byTo_;
+    std::vector<Xref> pending_;
+};
+
+#endif // XREFDATABASE_H
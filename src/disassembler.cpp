@@ -1,7 +1,790 @@
 #include "disassembler.h"
+#include "log.h"
+#include "projectdatabase.h"
 #include "sectionhandler.h"
+#include "workstealingscheduler.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
 
-Disassembler::Disassembler(SectionHandler *sectionHandler) : sectionHandler_(sectionHandler)
+// Size of the pieces sections are split into for parallel sweeps
+static const size_t PARALLEL_CHUNK_SIZE = 256 * 1024;
+
+// Number of instructions decoded per Architecture::decodeBatch call
+static const size_t DECODE_BATCH_SIZE = 256;
+
+// Instructions looked at between checks of the cancel flag
+static const size_t CANCEL_INTERVAL = 1 << 16;
+
+namespace
+{
+// Linear sweep of data[begin, end) where data starts at address. The last
+// instruction may extend past end. Each instruction is passed to sink.
+// Returns the offset the sweep stopped at
+template <typename Sink>
+size_t sweepRange(Architecture *arch, uint64_t address, ByteSpan data, size_t begin, size_t end, Sink sink)
+{
+    DecodedInstruction batch[DECODE_BATCH_SIZE];
+    
+    size_t offset = begin;
+    while (offset < end)
+    {
+        // Every instruction is at least one byte long
+        size_t count = std::min(DECODE_BATCH_SIZE, end - offset);
+        size_t decoded = arch->decodeBatch(address + offset, data.data() + offset, data.size() - offset, batch, count);
+        if (decoded == 0)
+        {
+            ++offset;
+            continue;
+        }
+        
+        for (size_t i = 0; i < decoded && offset < end; ++i)
+        {
+            sink(batch[i]);
+            offset += batch[i].length;
+        }
+    }
+    return offset;
+}
+
+struct SweepChunk
+{
+    SectionPtr section;
+    size_t begin;
+    size_t end;
+    
+    // Results of sweeping from begin, which may not be an instruction
+    // boundary of the sequential sweep
+    std::vector<DecodedInstruction> records;
+    size_t stop;
+};
+}
+
+Disassembler::Disassembler(SectionHandler *sectionHandler) : sectionHandler_(sectionHandler), cancel_(nullptr), imageBase_(0)
+{
+
+}
+
+void Disassembler::setArchitecture(ArchitecturePtr arch, uint64_t imageBase)
+{
+    arch_ = arch;
+    imageBase_ = imageBase;
+    seeds_.clear();
+    knownFunctions_.clear();
+    reset();
+}
+
+void Disassembler::reset()
+{
+    graph_.clear();
+    xrefs_.clear();
+    functions_.clear();
+    instructions_.clear(imageBase_);
+}
+
+void Disassembler::swap(Disassembler &other)
 {
+    std::swap(arch_, other.arch_);
+    std::swap(imageBase_, other.imageBase_);
+    std::swap(seeds_, other.seeds_);
+    std::swap(knownFunctions_, other.knownFunctions_);
+    std::swap(instructions_, other.instructions_);
+    std::swap(graph_, other.graph_);
+    std::swap(functions_, other.functions_);
+    std::swap(xrefs_, other.xrefs_);
+    
+    // The graphs refer to the stores by address
+    graph_.rebind(instructions_);
+    other.graph_.rebind(other.instructions_);
+}
+
+void Disassembler::addFunction(uint64_t start, uint64_t end, FunctionTable::Source source)
+{
+    knownFunctions_.add(start, end, source);
+}
+
+bool Disassembler::discoverFunctions(bool scanPrologues)
+{
+    functions_ = knownFunctions_;
+    
+    // Direct call targets in executable sections
+    for (size_t i = 0; i < instructions_.size(); ++i)
+    {
+        if (i % CANCEL_INTERVAL == 0 && cancelled())
+        {
+            functions_.clear();
+            return false;
+        }
+        
+        uint64_t target;
+        if (callTarget(instructions_, i, target))
+        {
+            functions_.add(target, 0, FunctionTable::SOURCE_CALL);
+        }
+    }
+    
+    if (scanPrologues)
+    {
+        for (const SectionPtr &section : executableSections())
+        {
+            scanForPrologues(imageBase_ + section->offset(), section->data());
+        }
+    }
+    if (cancelled())
+    {
+        functions_.clear();
+        return false;
+    }
+    
+    functions_.finalize(executableEnds());
+    
+    Log::normal(QString("Found %1 functions").arg(functions_.size()));
+    return true;
+}
+
+void Disassembler::scanForPrologues(uint64_t address, ByteSpan data)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t size = data.size();
+    
+    // Every signature starts with push ebp
+    for (size_t offset = 0; offset + 3 <= size; ++offset)
+    {
+        if (cancelled())
+        {
+            return;
+        }
+        
+        const void *found = memchr(bytes + offset, 0x55, size - offset - 2);
+        if (found == nullptr)
+        {
+            break;
+        }
+        offset = static_cast<const unsigned char*>(found) - bytes;
+        
+        // mov ebp, esp in either encoding
+        bool frame = (bytes[offset + 1] == 0x8B && bytes[offset + 2] == 0xEC) ||
+                     (bytes[offset + 1] == 0x89 && bytes[offset + 2] == 0xE5);
+        if (!frame)
+        {
+            continue;
+        }
+        
+        // Hot-patchable functions start with mov edi, edi
+        size_t start = offset;
+        if (start >= 2 && bytes[start - 2] == 0x8B && bytes[start - 1] == 0xFF)
+        {
+            start -= 2;
+        }
+        
+        // Only accept starts after padding or a return, or on a 16 byte
+        // boundary, to keep matches inside other code out
+        uint64_t startAddress = address + start;
+        bool boundary = start == 0 || (startAddress % 16) == 0 ||
+                        bytes[start - 1] == 0xCC || bytes[start - 1] == 0x90 || bytes[start - 1] == 0xC3;
+        if (!boundary)
+        {
+            continue;
+        }
+        
+        // Nor inside an instruction decoded from somewhere else
+        size_t index = instructions_.find(startAddress);
+        if (index != InstructionStore::npos && instructions_.address(index) != startAddress)
+        {
+            continue;
+        }
+        
+        functions_.add(startAddress, 0, FunctionTable::SOURCE_PROLOGUE);
+    }
+}
 
+bool Disassembler::buildGraph()
+{
+    if (!graph_.build(instructions_, cancel_))
+    {
+        return false;
+    }
+    Log::normal(QString("Built %1 basic blocks with %2 edges").arg(graph_.blockCount()).arg(graph_.edgeCount()));
+    return true;
+}
+
+bool Disassembler::linearSweep()
+{
+    if (!arch_)
+    {
+        Log::error("Cannot disassemble: no architecture set");
+        return false;
+    }
+    
+    reset();
+    
+    // The store must be filled in address order
+    std::vector<SectionPtr> sections = executableSections();
+    
+    // x86 code averages about 4 bytes per instruction
+    size_t totalSize = 0;
+    for (const SectionPtr &section : sections)
+    {
+        totalSize += section->data().size();
+    }
+    instructions_.reserve(totalSize / 4);
+    
+    for (const SectionPtr &section : sections)
+    {
+        if (cancelled())
+        {
+            reset();
+            return false;
+        }
+        sweepRange(arch_.get(), imageBase_ + section->offset(), section->data(), 0, section->data().size(), [this](const DecodedInstruction &record) {
+            instructions_.append(record.address, record.length, record.branchTypes, record.target, record.dataReference);
+        });
+    }
+    
+    xrefs_.addInstructions(instructions_, 0, instructions_.size());
+    Log::normal(QString("Linear sweep decoded %1 instructions (%2 KiB)").arg(instructions_.size()).arg(instructions_.memoryUsage() / 1024));
+    
+    return true;
+}
+
+bool Disassembler::parallelSweep(unsigned threadCount)
+{
+    if (!arch_)
+    {
+        Log::error("Cannot disassemble: no architecture set");
+        return false;
+    }
+    
+    reset();
+    
+    std::vector<SweepChunk> chunks;
+    for (const SectionPtr &section : executableSections())
+    {
+        size_t size = section->data().size();
+        for (size_t begin = 0; begin < size; begin += PARALLEL_CHUNK_SIZE)
+        {
+            SweepChunk chunk;
+            chunk.section = section;
+            chunk.begin = begin;
+            chunk.end = std::min(size, begin + PARALLEL_CHUNK_SIZE);
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    
+    WorkStealingScheduler scheduler(threadCount);
+    std::vector<ArchitecturePtr> archs;
+    for (unsigned i = 0; i < scheduler.threadCount(); ++i)
+    {
+        archs.push_back(arch_->clone());
+    }
+    
+    scheduler.run(chunks.size(), [&](unsigned worker, size_t index) {
+        if (cancelled())
+        {
+            return;
+        }
+        SweepChunk &chunk = chunks[index];
+        chunk.stop = sweepRange(archs[worker].get(), imageBase_ + chunk.section->offset(), chunk.section->data(), chunk.begin, chunk.end, [&chunk](const DecodedInstruction &record) {
+            chunk.records.push_back(record);
+        });
+    });
+    
+    if (cancelled())
+    {
+        return false;
+    }
+    
+    // Reconcile in address order. The sequential sweep enters a chunk where
+    // the previous chunk stopped. If that is not the chunk start, decode
+    // from there until reaching an instruction the chunk also decoded;
+    // both sweeps are identical from that point on
+    size_t total = 0;
+    for (const SweepChunk &chunk : chunks)
+    {
+        total += chunk.records.size();
+    }
+    instructions_.reserve(total);
+    
+    size_t expected = 0;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        SweepChunk &chunk = chunks[i];
+        if (i == 0 || chunk.section != chunks[i - 1].section)
+        {
+            expected = 0;
+        }
+        
+        uint64_t sectionAddress = imageBase_ + chunk.section->offset();
+        ByteSpan data = chunk.section->data();
+        
+        auto next = chunk.records.begin();
+        while (expected != chunk.begin && expected < chunk.end)
+        {
+            while (next != chunk.records.end() && next->address < sectionAddress + expected)
+            {
+                ++next;
+            }
+            if (next != chunk.records.end() && next->address == sectionAddress + expected)
+            {
+                break;
+            }
+            
+            // Decode a single step of the sequential sweep
+            expected = sweepRange(arch_.get(), sectionAddress, data, expected, expected + 1, [this](const DecodedInstruction &record) {
+                instructions_.append(record.address, record.length, record.branchTypes, record.target, record.dataReference);
+            });
+        }
+        
+        if (expected >= chunk.end && expected != chunk.begin)
+        {
+            // The sequential sweep decoded past the whole chunk
+            continue;
+        }
+        
+        for (; next != chunk.records.end(); ++next)
+        {
+            instructions_.append(next->address, next->length, next->branchTypes, next->target, next->dataReference);
+        }
+        expected = chunk.stop;
+        
+        // Release the chunk results as they are merged
+        std::vector<DecodedInstruction>().swap(chunk.records);
+    }
+    
+    xrefs_.addInstructions(instructions_, 0, instructions_.size());
+    Log::normal(QString("Parallel sweep decoded %1 instructions in %2 chunks on %3 threads").arg(instructions_.size()).arg(chunks.size()).arg(scheduler.threadCount()));
+    
+    return true;
+}
+
+void Disassembler::addSeed(uint64_t address)
+{
+    seeds_.push_back(address);
+}
+
+bool Disassembler::recursiveDescent()
+{
+    if (!arch_)
+    {
+        Log::error("Cannot disassemble: no architecture set");
+        return false;
+    }
+    
+    reset();
+    
+    std::vector<SectionPtr> sections = executableSections();
+    if (sections.empty())
+    {
+        return true;
+    }
+    
+    // One bit per byte of the executable address range
+    uint64_t rangeStart = imageBase_ + sections.front()->offset();
+    uint64_t rangeEnd = rangeStart;
+    for (const SectionPtr &section : sections)
+    {
+        rangeEnd = std::max(rangeEnd, imageBase_ + section->offset() + section->data().size());
+    }
+    std::vector<uint64_t> visited((rangeEnd - rangeStart + 63) / 64);
+    
+    std::vector<uint64_t> worklist(seeds_.rbegin(), seeds_.rend());
+    std::vector<DecodedInstruction> records;
+    
+    while (!worklist.empty())
+    {
+        if (cancelled())
+        {
+            return false;
+        }
+        
+        uint64_t address = worklist.back();
+        worklist.pop_back();
+        
+        // Find the section once per flow; flow stops at the section end
+        auto it = std::upper_bound(sections.begin(), sections.end(), address, [this](uint64_t address, const SectionPtr &section) {
+            return address < imageBase_ + section->offset();
+        });
+        if (it == sections.begin())
+        {
+            continue;
+        }
+        --it;
+        uint64_t sectionStart = imageBase_ + (*it)->offset();
+        ByteSpan data = (*it)->data();
+        
+        while (address >= sectionStart && address < sectionStart + data.size())
+        {
+            uint64_t bit = address - rangeStart;
+            if (visited[bit / 64] & (1ull << (bit % 64)))
+            {
+                break;
+            }
+            
+            size_t offset = address - sectionStart;
+            InstructionInfo iinfo;
+            if (!arch_->instructionInfo(address, data.data() + offset, data.size() - offset, iinfo))
+            {
+                break;
+            }
+            
+            // Instructions overlapping already decoded bytes are dropped so
+            // the store never holds overlapping instructions
+            bool overlaps = false;
+            for (uint64_t i = bit + 1; i < bit + iinfo.length(); ++i)
+            {
+                overlaps |= (visited[i / 64] & (1ull << (i % 64))) != 0;
+            }
+            if (overlaps)
+            {
+                break;
+            }
+            
+            for (uint64_t i = bit; i < bit + iinfo.length(); ++i)
+            {
+                visited[i / 64] |= 1ull << (i % 64);
+            }
+            
+            DecodedInstruction record;
+            record.address = address;
+            record.target = iinfo.branch(0);
+            record.dataReference = iinfo.dataReference();
+            record.length = iinfo.length();
+            record.branchTypes = iinfo.branchTypes();
+            records.push_back(record);
+            
+            uint8_t types = record.branchTypes;
+            if (InstructionInfo::hasTarget(types) && (types & InstructionInfo::BRANCH_INDIRECT) == 0 &&
+                record.target >= rangeStart && record.target < rangeEnd)
+            {
+                worklist.push_back(record.target);
+            }
+            
+            if ((types & InstructionInfo::BRANCH_STOP) ||
+                ((types & InstructionInfo::BRANCH_ALWAYS) && (types & InstructionInfo::BRANCH_CALL) == 0))
+            {
+                break;
+            }
+            
+            address += iinfo.length();
+        }
+    }
+    
+    store(records, instructions_);
+    
+    xrefs_.addInstructions(instructions_, 0, instructions_.size());
+    Log::normal(QString("Recursive descent decoded %1 instructions from %2 seeds").arg(instructions_.size()).arg(seeds_.size()));
+    
+    return true;
+}
+
+void Disassembler::undefine(uint64_t begin, uint64_t end)
+{
+    size_t first = instructions_.find(begin);
+    if (first == InstructionStore::npos)
+    {
+        first = instructions_.lowerBound(begin);
+    }
+    size_t last = instructions_.lowerBound(end);
+    
+    if (first < last)
+    {
+        InstructionStore none;
+        none.clear(imageBase_);
+        edit(first, last, none);
+    }
+}
+
+bool Disassembler::defineCode(uint64_t address)
+{
+    if (!arch_)
+    {
+        Log::error("Cannot disassemble: no architecture set");
+        return false;
+    }
+    
+    // Code that starts elsewhere and covers address gives way
+    size_t first = instructions_.find(address);
+    size_t last;
+    if (first == InstructionStore::npos)
+    {
+        first = last = instructions_.lowerBound(address);
+    }
+    else if (instructions_.address(first) == address)
+    {
+        return true;
+    }
+    else
+    {
+        last = first + 1;
+    }
+    
+    // Decoded instructions by address, to find overlaps
+    std::map<uint64_t, DecodedInstruction> decoded;
+    auto occupied = [&](uint64_t begin, uint64_t end) {
+        size_t index = instructions_.find(begin);
+        if (index != InstructionStore::npos && (index < first || index >= last))
+        {
+            return true;
+        }
+        index = instructions_.lowerBound(begin);
+        if (index >= first && index < last)
+        {
+            index = last;
+        }
+        if (index < instructions_.size() && instructions_.address(index) < end)
+        {
+            return true;
+        }
+        
+        auto next = decoded.upper_bound(begin);
+        if (next != decoded.end() && next->first < end)
+        {
+            return true;
+        }
+        return next != decoded.begin() && std::prev(next)->first + std::prev(next)->second.length > begin;
+    };
+    
+    // The same flow as recursive descent, but bounded by the code that is
+    // already there instead of a bitmap of the whole image
+    std::vector<uint64_t> worklist(1, address);
+    while (!worklist.empty())
+    {
+        uint64_t current = worklist.back();
+        worklist.pop_back();
+        
+        SectionPtr section;
+        if (current >= imageBase_ && current - imageBase_ <= 0xFFFFFFFFull)
+        {
+            section = sectionHandler_->find(static_cast<uint32_t>(current - imageBase_));
+        }
+        if (!section || !section->executable())
+        {
+            continue;
+        }
+        uint64_t sectionStart = imageBase_ + section->offset();
+        ByteSpan data = section->data();
+        
+        while (current >= sectionStart && current < sectionStart + data.size())
+        {
+            size_t offset = current - sectionStart;
+            InstructionInfo iinfo;
+            if (!arch_->instructionInfo(current, data.data() + offset, data.size() - offset, iinfo) ||
+                occupied(current, current + iinfo.length()))
+            {
+                break;
+            }
+            
+            DecodedInstruction record;
+            record.address = current;
+            record.target = iinfo.branch(0);
+            record.dataReference = iinfo.dataReference();
+            record.length = iinfo.length();
+            record.branchTypes = iinfo.branchTypes();
+            decoded[current] = record;
+            
+            uint8_t types = record.branchTypes;
+            if (InstructionInfo::hasTarget(types) && (types & InstructionInfo::BRANCH_INDIRECT) == 0)
+            {
+                worklist.push_back(record.target);
+            }
+            
+            if ((types & InstructionInfo::BRANCH_STOP) ||
+                ((types & InstructionInfo::BRANCH_ALWAYS) && (types & InstructionInfo::BRANCH_CALL) == 0))
+            {
+                break;
+            }
+            
+            current += iinfo.length();
+        }
+    }
+    
+    if (decoded.empty())
+    {
+        Log::warning(QString("No code can be decoded at 0x%1").arg(address, 0, 16));
+        return false;
+    }
+    
+    std::vector<DecodedInstruction> records;
+    records.reserve(decoded.size());
+    for (const std::pair<const uint64_t, DecodedInstruction> &entry : decoded)
+    {
+        records.push_back(entry.second);
+    }
+    InstructionStore added;
+    added.clear(imageBase_);
+    store(records, added);
+    
+    edit(first, last, added);
+    return true;
+}
+
+void Disassembler::defineFunction(uint64_t start, uint64_t end)
+{
+    knownFunctions_.add(start, end, FunctionTable::SOURCE_USER);
+    functions_.insert(start, end, FunctionTable::SOURCE_USER, executableEnds());
+}
+
+bool Disassembler::undefineFunction(uint64_t start)
+{
+    size_t index = functions_.lowerBound(start);
+    if (index == functions_.size() || functions_.start(index) != start)
+    {
+        return false;
+    }
+    
+    functions_.removeSources(index, functions_.sources(index), executableEnds());
+    return true;
+}
+
+void Disassembler::edit(size_t first, size_t last, const InstructionStore &added)
+{
+    // What the edit can change: the removed and added instructions and
+    // the instructions they branch to. Call targets are functions instead
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<uint64_t> removedCalls;
+    std::vector<uint64_t> addedCalls;
+    auto collect = [&](const InstructionStore &instructions, size_t begin, size_t end, std::vector<uint64_t> &calls) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            uint64_t address = instructions.address(i);
+            ranges.push_back(std::make_pair(address, address + instructions.length(i)));
+            
+            uint64_t target;
+            if (callTarget(instructions, i, target))
+            {
+                calls.push_back(target);
+            }
+            else if ((instructions.branchTypes(i) & InstructionInfo::BRANCH_INDIRECT) == 0 &&
+                     instructions.target(i, target))
+            {
+                ranges.push_back(std::make_pair(target, target + 1));
+            }
+        }
+    };
+    collect(instructions_, first, last, removedCalls);
+    collect(added, 0, added.size(), addedCalls);
+    
+    // Taken before the store changes, since they are found from the old
+    // blocks
+    std::vector<ControlFlowGraph::Region> regions = graph_.affectedRegions(ranges);
+    
+    if (first < last)
+    {
+        xrefs_.removeFrom(instructions_.address(first), instructions_.address(last - 1) + instructions_.length(last - 1));
+    }
+    InstructionStore::Splice splice = instructions_.replace(first, last, added);
+    xrefs_.addInstructions(added, 0, added.size());
+    graph_.update(splice, regions, xrefs_);
+    
+    // Functions found from calls follow their callers, once there are any
+    if (functions_.size() == 0)
+    {
+        return;
+    }
+    std::vector<uint64_t> ends = executableEnds();
+    std::vector<XrefDatabase::Xref> references;
+    for (uint64_t target : removedCalls)
+    {
+        xrefs_.referencesTo(target, references);
+        bool called = std::any_of(references.begin(), references.end(), [](const XrefDatabase::Xref &reference) {
+            return reference.type == XrefDatabase::XREF_CALL;
+        });
+        size_t index = functions_.lowerBound(target);
+        if (!called && index < functions_.size() && functions_.start(index) == target)
+        {
+            functions_.removeSources(index, FunctionTable::SOURCE_CALL, ends);
+        }
+    }
+    for (uint64_t target : addedCalls)
+    {
+        functions_.insert(target, 0, FunctionTable::SOURCE_CALL, ends);
+    }
+}
+
+void Disassembler::save(ProjectDatabaseWriter &writer) const
+{
+    instructions_.save(writer);
+    graph_.save(writer);
+    functions_.save(writer);
+    xrefs_.save(writer);
+}
+
+bool Disassembler::load(const ProjectDatabase &database)
+{
+    reset();
+    
+    bool ok = instructions_.load(database) && instructions_.base() == imageBase_ &&
+              graph_.load(database, instructions_) && functions_.load(database) && xrefs_.load(database);
+    if (!ok)
+    {
+        Log::error("The analysis in the project database is damaged or belongs to another image");
+        reset();
+        return false;
+    }
+    
+    Log::normal(QString("Loaded %1 instructions, %2 basic blocks and %3 functions").arg(instructions_.size()).arg(graph_.blockCount()).arg(functions_.size()));
+    return true;
+}
+
+ByteSpan Disassembler::bytes(uint64_t address) const
+{
+    if (address < imageBase_ || address - imageBase_ > 0xFFFFFFFFull)
+    {
+        return ByteSpan();
+    }
+    
+    return sectionHandler_->bytes(static_cast<uint32_t>(address - imageBase_));
+}
+
+std::vector<uint64_t> Disassembler::executableEnds()
+{
+    std::vector<uint64_t> ends;
+    for (const SectionPtr &section : executableSections())
+    {
+        ends.push_back(imageBase_ + section->offset() + std::max<uint64_t>(section->size(), section->data().size()));
+    }
+    std::sort(ends.begin(), ends.end());
+    return ends;
+}
+
+bool Disassembler::callTarget(const InstructionStore &instructions, size_t index, uint64_t &target) const
+{
+    uint8_t types = instructions.branchTypes(index);
+    if (!(types & InstructionInfo::BRANCH_CALL) || (types & InstructionInfo::BRANCH_INDIRECT) ||
+        !instructions.target(index, target) || target < imageBase_ || target - imageBase_ > 0xFFFFFFFFull)
+    {
+        return false;
+    }
+    
+    SectionPtr section = sectionHandler_->find(static_cast<uint32_t>(target - imageBase_));
+    return section && section->executable();
+}
+
+std::vector<SectionPtr> Disassembler::executableSections()
+{
+    std::vector<SectionPtr> sections;
+    for (const SectionPtr &section : sectionHandler_->sections())
+    {
+        if (section->executable())
+        {
+            sections.push_back(section);
+        }
+    }
+    std::sort(sections.begin(), sections.end(), [](const SectionPtr &a, const SectionPtr &b) {
+        return a->offset() < b->offset();
+    });
+    return sections;
+}
+
+void Disassembler::store(std::vector<DecodedInstruction> &records, InstructionStore &instructions)
+{
+    std::sort(records.begin(), records.end(), [](const DecodedInstruction &a, const DecodedInstruction &b) {
+        return a.address < b.address;
+    });
+    
+    instructions.reserve(records.size());
+    for (const DecodedInstruction &record : records)
+    {
+        instructions.append(record.address, record.length, record.branchTypes, record.target, record.dataReference);
+    }
 }
@@ -1,7 +1,17 @@
 #ifndef DISASSEMBLER_H
 #define DISASSEMBLER_H
+#include "arch/architecture.h"
+#include "disasm/controlflowgraph.h"
+#include "disasm/decodedinstruction.h"
+#include "disasm/functiontable.h"
+#include "disasm/instructionstore.h"
+#include "disasm/xrefdatabase.h"
+#include "section.h"
+#include <atomic>
 
 
+class ProjectDatabase;
+class ProjectDatabaseWriter;
 class SectionHandler;
 
 class Disassembler
@@ -9,8 +19,163 @@ class Disassembler
 public:
     Disassembler(SectionHandler *sectionHandler);
     
+    /* Sets the architecture used for decoding and the address the section
+     * offsets are relative to. Clears previous results */
+    void setArchitecture(ArchitecturePtr arch, uint64_t imageBase);
+    
+    /* Clears all results */
+    void reset();
+    
+    /* Decoding, graph and function passes stop early and return false
+     * once flag is set. Null disables cancellation */
+    inline void setCancelFlag(const std::atomic<bool> *flag)
+    {
+        cancel_ = flag;
+    }
+    
+    inline bool cancelled() const
+    {
+        return cancel_ && cancel_->load(std::memory_order_relaxed);
+    }
+    
+    /* Exchanges the architecture and results with other. Each keeps its
+     * section handler and cancel flag, so the handlers should hold the
+     * same sections */
+    void swap(Disassembler &other);
+    
+    /* Decodes every executable section from start to end. Bytes that
+     * cannot be decoded are skipped. Returns false if no architecture
+     * is set */
+    bool linearSweep();
+    
+    /* Produces the same result as linearSweep, decoding the sections in
+     * chunks on a work-stealing pool with one architecture copy per
+     * worker. Instructions that cross chunk edges are reconciled in
+     * address order afterwards, so the result does not depend on the
+     * thread count. A thread count of zero uses one thread per core */
+    bool parallelSweep(unsigned threadCount = 0);
+    
+    /* Adds an address for recursive descent to start from */
+    void addSeed(uint64_t address);
+    
+    /* Decodes from the seeds, following branch and call targets through
+     * a worklist. Flow stops at returns, unconditional jumps, bytes that
+     * cannot be decoded and bytes that were already decoded, so each byte
+     * is decoded at most once. Returns false if no architecture is set */
+    bool recursiveDescent();
+    
+    /* Marks the bytes [begin, end) as data by removing the instructions
+     * overlapping them. Only the blocks, references and functions around
+     * the removed instructions are updated, so an edit costs about the
+     * same on any size of image */
+    void undefine(uint64_t begin, uint64_t end);
+    
+    /* Marks address as code and decodes from it as recursive descent
+     * does, following branches through bytes that are not decoded yet.
+     * An instruction overlapping address without starting there is
+     * removed first. Updated like undefine(). Returns false if no
+     * architecture is set or nothing can be decoded at address */
+    bool defineCode(uint64_t address);
+    
+    inline const InstructionStore &instructions() const
+    {
+        return instructions_;
+    }
+    
+    /* Adds a function known from the file format, e.g. from the exception
+     * directory, exports or the entry point. end is zero when unknown.
+     * Kept until the architecture changes */
+    void addFunction(uint64_t start, uint64_t end, FunctionTable::Source source);
+    
+    /* Builds the function table from the known functions and the targets
+     * of decoded direct calls. With scanPrologues, executable sections are
+     * also scanned for common 32-bit x86 prologues, for images that have
+     * no exception directory. Returns false with no functions if
+     * cancelled */
+    bool discoverFunctions(bool scanPrologues);
+    
+    /* Adds a function defined by the user. end is zero to run it to the
+     * next function. Kept until the architecture changes */
+    void defineFunction(uint64_t start, uint64_t end);
+    
+    /* Removes the function starting at start until functions are
+     * discovered again. Returns false if there is none */
+    bool undefineFunction(uint64_t start);
+    
+    inline const FunctionTable &functions() const
+    {
+        return functions_;
+    }
+    
+    /* Splits the decoded instructions into basic blocks. Call after
+     * decoding; decoding again or resetting clears the graph. Returns
+     * false with no graph if cancelled */
+    bool buildGraph();
+    
+    /* Returns the references made by the decoded instructions. Each
+     * decoding pass adds its instructions */
+    inline const XrefDatabase &xrefs() const
+    {
+        return xrefs_;
+    }
+    
+    inline const ControlFlowGraph &graph() const
+    {
+        return graph_;
+    }
+    
+    inline ArchitecturePtr architecture() const
+    {
+        return arch_;
+    }
+    
+    /* Adds the results to a database: instructions, graph, functions and
+     * references. They must not change before the database is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+    
+    /* Replaces the results with the ones in database instead of decoding.
+     * The architecture and image base must be set as for the analysis
+     * that was saved. Returns false and clears the results if the tables
+     * are missing or do not match */
+    bool load(const ProjectDatabase &database);
+    
+    /* Returns the section bytes from address to the end of its section,
+     * or an empty span if address is not backed by section data */
+    ByteSpan bytes(uint64_t address) const;
+    
 private:
+    // Returns the executable sections sorted by address
+    std::vector<SectionPtr> executableSections();
+    
+    // Returns the sorted end addresses of the executable sections
+    std::vector<uint64_t> executableEnds();
+    
+    /* Gets the target of a direct call into an executable section. Returns
+     * false if the instruction is not one */
+    bool callTarget(const InstructionStore &instructions, size_t index, uint64_t &target) const;
+    
+    /* Replaces instructions [first, last) with added, which must not
+     * overlap the others, and updates what depends on them */
+    void edit(size_t first, size_t last, const InstructionStore &added);
+    
+    // Adds the prologue matches in data, which starts at address. Stops
+    // early if cancelled
+    void scanForPrologues(uint64_t address, ByteSpan data);
+    
+    // Appends records in any order to an empty store
+    void store(std::vector<DecodedInstruction> &records, InstructionStore &instructions);
+    
     SectionHandler *sectionHandler_;
+    const std::atomic<bool> *cancel_;
+    ArchitecturePtr arch_;
+    uint64_t imageBase_;
+    std::vector<uint64_t> seeds_;
+    FunctionTable knownFunctions_;
+    
+    InstructionStore instructions_;
+    ControlFlowGraph graph_;
+    FunctionTable functions_;
+    XrefDatabase xrefs_;
 };
 
 #endif // DISASSEMBLER_H
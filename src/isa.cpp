@@ -23,6 +23,12 @@ ISA::ISA(int &argc, char *argv[]) : QApplication(argc, argv), disassembler_(&sec
     Log::normal("Loaded ISA");
 }
 
+ISA::~ISA()
+{
+    // The log thread passes messages to the model, which must outlive it
+    Log::shutdown();
+}
+
 
 
 ISA *ISA::get()
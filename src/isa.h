@@ -12,6 +12,7 @@ class ISA : public QApplication
     Q_OBJECT
 public:
     ISA (int &argc, char *argv[]);
+    ~ISA();
     
     /* Returns a pointer to the global ISA object */
     static ISA *get();
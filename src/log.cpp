@@ -1,19 +1,372 @@
 #include "log.h"
 #include "logmodel.h"
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// Number of messages the queue holds; a power of two
+static const size_t QUEUE_SIZE = 8192;
+
+// Most messages written and passed to the model at once
+static const int BATCH_SIZE = 256;
+
+// How long the writer sleeps when the queue is empty before looking again.
+// Bounds the delay when a producer's wakeup races with falling asleep
+static const std::chrono::milliseconds IDLE_TIMEOUT(20);
+
+static std::atomic<bool> modelEnabled(true);
+static std::atomic<bool> normalToStderr(false);
+
+namespace
+{
+
+/* A bounded multi-producer, single-consumer queue of messages. Every slot
+ * carries a sequence number telling whether it is free for the producer
+ * holding a given ticket or full for the consumer, so a producer claims a
+ * slot with one compare-exchange on the head and publishes it with one
+ * store. Nothing blocks and nothing is allocated. */
+class MessageQueue
+{
+public:
+    MessageQueue() : slots_(new Slot[QUEUE_SIZE]), head_(0), tail_(0)
+    {
+        for (size_t i = 0; i < QUEUE_SIZE; ++i)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MessageQueue()
+    {
+        delete[] slots_;
+    }
+
+    /* Returns false without waiting if the queue is full */
+    bool push(Log::MessageLevel level, const QString &text)
+    {
+        size_t position = head_.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;)
+        {
+            slot = &slots_[position & (QUEUE_SIZE - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) -
+                                  static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (head_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->message.level = level;
+        slot->message.text = text;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Only called by the writer thread. Returns false if the next message
+     * has not been published yet */
+    bool pop(Log::Message &message)
+    {
+        Slot &slot = slots_[tail_ & (QUEUE_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1)
+        {
+            return false;
+        }
+
+        message.level = slot.message.level;
+        message.text.swap(slot.message.text);
+        slot.message.text = QString();
+        slot.sequence.store(tail_ + QUEUE_SIZE, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+    bool empty() const
+    {
+        const Slot &slot = slots_[tail_ & (QUEUE_SIZE - 1)];
+        return slot.sequence.load(std::memory_order_acquire) != tail_ + 1;
+    }
+
+    // Number of messages claimed by producers so far
+    size_t pushed() const
+    {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    // Number of messages taken by the consumer so far
+    size_t popped() const
+    {
+        return tail_;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        Log::Message message;
+    };
+
+    Slot *slots_;
+
+    // Producers and the consumer write these; keep them on separate lines
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) size_t tail_;
+};
+
+/* Owns the queue and the thread that drains it */
+class Writer
+{
+public:
+    Writer()
+        : running_(true), sleeping_(false), dropped_(0), written_(0),
+          thread_(&Writer::run, this)
+    {
+    }
+
+    void log(Log::MessageLevel level, const QString &message)
+    {
+        if (!queue_.push(level, message))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Pairs with the fence in run() so that either the writer sees the
+        // message or this sees it going to sleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed))
+        {
+            wake();
+        }
+    }
+
+    void flush()
+    {
+        size_t target = queue_.pushed();
+        wake();
+        while (written_.load(std::memory_order_acquire) < target &&
+               running_.load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    /* Stops the thread after it has written everything queued so far and
+     * writes whatever arrived in the meantime from the calling thread */
+    void stop()
+    {
+        running_.store(false);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sleeping_.store(false);
+            condition_.notify_one();
+        }
+        thread_.join();
+
+        while (drain(false))
+        {
+        }
+    }
+
+    static void write(const QVector<Log::Message> &batch)
+    {
+        std::string out;
+        std::string err;
+        bool toStderr = normalToStderr.load(std::memory_order_relaxed);
+        for (const Log::Message &message : batch)
+        {
+            std::string &target =
+                message.level == Log::Normal && !toStderr ? out : err;
+            target += message.text.toStdString();
+            target += '\n';
+        }
+
+        if (!out.empty())
+        {
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+        }
+        if (!err.empty())
+        {
+            fwrite(err.data(), 1, err.size(), stderr);
+            fflush(stderr);
+        }
+    }
+
+private:
+    void wake()
+    {
+        if (sleeping_.exchange(false))
+        {
+            condition_.notify_one();
+        }
+    }
+
+    /* Writes one batch of queued messages. Returns false if there were
+     * none */
+    bool drain(bool forward)
+    {
+        QVector<Log::Message> batch;
+        Log::Message message;
+        while (batch.size() < BATCH_SIZE && queue_.pop(message))
+        {
+            batch.append(message);
+        }
+
+        size_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped != 0)
+        {
+            Log::Message notice;
+            notice.level = Log::Warning;
+            notice.text = QString("%1 log messages were dropped because the "
+                                  "queue was full")
+                              .arg(dropped);
+            batch.append(notice);
+        }
+
+        if (batch.isEmpty())
+        {
+            return false;
+        }
+
+        write(batch);
+        written_.store(queue_.popped(), std::memory_order_release);
+
+        if (forward && modelEnabled.load(std::memory_order_relaxed))
+        {
+            QMetaObject::invokeMethod(LogModel::get(), "append",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QVector<Log::Message>, batch));
+        }
+        return true;
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            if (drain(true))
+            {
+                continue;
+            }
+            if (!running_.load())
+            {
+                break;
+            }
+
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!queue_.empty())
+            {
+                sleeping_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, IDLE_TIMEOUT,
+                                [this] { return !sleeping_.load(); });
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    MessageQueue queue_;
+    std::atomic<bool> running_;
+    std::atomic<bool> sleeping_;
+    std::atomic<size_t> dropped_;
+
+    // Messages popped and written so far, for flush()
+    std::atomic<size_t> written_;
+
+    // Only used to sleep; producers never take it
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread thread_;
+};
+
+} // namespace
+
+// Null after shutdown
+static std::atomic<Writer *> writer(nullptr);
+static std::once_flag writerStarted;
+
+// The writer is built in here rather than with new, which does not honour
+// the alignment of the queue's members before C++17. It is never destroyed
+static std::aligned_storage<sizeof(Writer), alignof(Writer)>::type writerStorage;
+
+static Writer *getWriter()
+{
+    std::call_once(writerStarted, [] {
+        qRegisterMetaType<QVector<Log::Message>>("QVector<Log::Message>");
+        writer.store(new (&writerStorage) Writer);
+        std::atexit(Log::shutdown);
+    });
+    return writer.load(std::memory_order_acquire);
+}
 
 void Log::log(Log::MessageLevel level, const QString &message)
 {
-    switch (level)
+    Writer *current = getWriter();
+    if (current != nullptr)
     {
-    case Normal:
-        std::cout << message.toStdString() << std::endl;
-        break;
-    case Warning:
-    case Error:
-        std::cerr << message.toStdString() << std::endl;
-        break;
+        current->log(level, message);
+        return;
     }
 
-    LogModel::get()->append(level, message);
+    Message late;
+    late.level = level;
+    late.text = message;
+    Writer::write(QVector<Message>() << late);
+}
+
+void Log::flush()
+{
+    Writer *current = getWriter();
+    if (current != nullptr)
+    {
+        current->flush();
+    }
+}
+
+void Log::shutdown()
+{
+    getWriter();
+
+    // The writer is stopped but not destroyed, since another thread may
+    // still be inside log() with the old pointer
+    Writer *current = writer.exchange(nullptr);
+    if (current != nullptr)
+    {
+        current->stop();
+    }
+}
+
+void Log::setModelEnabled(bool enabled)
+{
+    modelEnabled = enabled;
+}
+
+void Log::setNormalToStderr(bool enabled)
+{
+    normalToStderr = enabled;
 }
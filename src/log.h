@@ -2,7 +2,13 @@
 #define LOG_H
 
 #include <QMetaType>
+#include <QString>
+#include <QVector>
 
+/* Messages are queued without locking and written by a background thread,
+ * so logging from analysis workers neither blocks nor races with the GUI.
+ * The background thread prints them to stdout or stderr and passes them to
+ * the LogModel in batches on the GUI thread. */
 class Log
 {
 public:
@@ -13,8 +19,34 @@ public:
         Error
     };
 
+    struct Message
+    {
+        MessageLevel level;
+        QString text;
+    };
+
+    /* Queues a message. Never blocks; if the queue is full the message is
+     * dropped and the number of dropped messages is reported later */
     static void log(MessageLevel level, const QString &message);
 
+    /* Blocks until every message queued before the call has been written */
+    static void flush();
+
+    /* Writes the remaining messages and stops the background thread. Later
+     * messages are written synchronously and not passed to the model. Also
+     * runs at exit, but the GUI should call it while the model still
+     * exists */
+    static void shutdown();
+
+    /* Enables or disables forwarding messages to the LogModel. The model
+     * may only be used from the GUI thread, so it must be disabled when
+     * there is no GUI or when logging from worker threads */
+    static void setModelEnabled(bool enabled);
+
+    /* Sends Normal messages to stderr instead of stdout. Used when stdout
+     * carries program output */
+    static void setNormalToStderr(bool enabled);
+
     inline static void normal(const QString &message)
     {
         log(Normal, message);
@@ -32,5 +64,6 @@ public:
 };
 
 Q_DECLARE_METATYPE(Log::MessageLevel)
+Q_DECLARE_METATYPE(Log::Message)
 
 #endif // LOG_H
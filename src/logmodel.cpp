@@ -1,4 +1,12 @@
 #include "logmodel.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <algorithm>
+
+// Messages arriving within this many milliseconds are inserted together
+static const int FRAME_INTERVAL = 16;
+
+static const int DEFAULT_MAXIMUM_ENTRIES = 10000;
 
 LogModel *LogModel::get()
 {
@@ -6,26 +14,100 @@ LogModel *LogModel::get()
     return &model;
 }
 
-LogModel::LogModel(QObject *parent) : QAbstractListModel(parent)
+LogModel::LogModel(QObject *parent)
+    : QAbstractListModel(parent), first_(0), count_(0),
+      maximumEntries_(DEFAULT_MAXIMUM_ENTRIES),
+      entries_(DEFAULT_MAXIMUM_ENTRIES)
+{
+    // Queued calls are delivered to the thread the model lives in
+    if (parent == nullptr && QCoreApplication::instance() != nullptr)
+    {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    insertTimer_ = new QTimer(this);
+    insertTimer_->setSingleShot(true);
+    insertTimer_->setInterval(FRAME_INTERVAL);
+    connect(insertTimer_, &QTimer::timeout, this, &LogModel::insertPending);
+}
+
+void LogModel::append(const QVector<Log::Message> &messages)
+{
+    pending_.insert(pending_.end(), messages.begin(), messages.end());
+
+    // Messages that would be evicted in the same frame are never shown
+    if (pending_.size() > static_cast<size_t>(maximumEntries_))
+    {
+        pending_.erase(pending_.begin(), pending_.end() - maximumEntries_);
+    }
+
+    if (!pending_.empty() && !insertTimer_->isActive())
+    {
+        insertTimer_->start();
+    }
+}
+
+void LogModel::setMaximumEntries(int count)
 {
+    count = std::max(count, 1);
+    insertPending();
+
+    // Rebuild the ring in row order with the new size
+    evict(count_ - count);
+    std::vector<Log::Message> entries(count);
+    for (int row = 0; row < count_; ++row)
+    {
+        entries[row] = entry(row);
+    }
+
+    entries_.swap(entries);
+    first_ = 0;
+    maximumEntries_ = count;
 }
 
-void LogModel::append(Log::MessageLevel level, const QString &text)
+void LogModel::insertPending()
 {
-    beginInsertRows(QModelIndex(), entries_.size(), entries_.size());
+    insertTimer_->stop();
+    if (pending_.empty())
+    {
+        return;
+    }
 
-    Entry entry;
-    entry.level = level;
-    entry.text = text;
-    entries_.append(entry);
+    int count = static_cast<int>(pending_.size());
+    evict(count_ + count - maximumEntries_);
 
+    beginInsertRows(QModelIndex(), count_, count_ + count - 1);
+    for (Log::Message &message : pending_)
+    {
+        entries_[(first_ + count_) % entries_.size()] = message;
+        ++count_;
+    }
     endInsertRows();
+
+    pending_.clear();
+}
+
+void LogModel::evict(int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), 0, count - 1);
+    for (int row = 0; row < count; ++row)
+    {
+        entries_[(first_ + row) % entries_.size()].text = QString();
+    }
+    first_ = (first_ + count) % entries_.size();
+    count_ -= count;
+    endRemoveRows();
 }
 
 QVariant LogModel::data(const QModelIndex &index, int role) const
 {
     int row = index.row();
-    if (row < 0 || row >= entries_.size())
+    if (row < 0 || row >= count_)
     {
         return QVariant();
     }
@@ -34,9 +116,9 @@ QVariant LogModel::data(const QModelIndex &index, int role) const
     {
     case Qt::DisplayRole:
     case Qt::EditRole:
-        return entries_[row].text;
+        return entry(row).text;
     case LevelRole:
-        return entries_[row].level;
+        return entry(row).level;
     default:
         return QVariant();
     }
@@ -44,5 +126,5 @@ QVariant LogModel::data(const QModelIndex &index, int role) const
 
 int LogModel::rowCount(const QModelIndex &parent) const
 {
-    return entries_.size();
+    return count_;
 }
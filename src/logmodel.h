@@ -3,7 +3,14 @@
 
 #include "log.h"
 #include <QAbstractListModel>
+#include <vector>
 
+class QTimer;
+
+/* The most recent log messages. Messages arriving within one frame are
+ * inserted as a single batch of rows, and the oldest rows are removed once
+ * the maximum is reached, so a flood of warnings costs the views a few
+ * updates per second rather than one per message. */
 class LogModel : public QAbstractListModel
 {
     Q_OBJECT
@@ -13,7 +20,19 @@ public:
 
     LogModel(QObject *parent = 0);
 
-    void append(Log::MessageLevel level, const QString &text);
+    /* Queues messages to be inserted at the end of the next frame. Called
+     * by the log's writer thread through a queued connection, so it always
+     * runs on the GUI thread */
+    Q_INVOKABLE void append(const QVector<Log::Message> &messages);
+
+    /* Sets the number of messages kept. Older ones are removed. The default
+     * is 10000 */
+    void setMaximumEntries(int count);
+
+    inline int maximumEntries() const
+    {
+        return maximumEntries_;
+    }
 
     QVariant data(const QModelIndex &index, int role) const override;
 
@@ -24,14 +43,29 @@ public:
         LevelRole = Qt::UserRole
     };
 
+public slots:
+    /* Inserts the queued messages now */
+    void insertPending();
+
 private:
-    struct Entry
+    const Log::Message &entry(int row) const
     {
-        Log::MessageLevel level;
-        QString text;
-    };
+        return entries_[(first_ + row) % entries_.size()];
+    }
+
+    // Removes the count oldest rows
+    void evict(int count);
+
+    size_t first_;
+    int count_;
+    int maximumEntries_;
+
+    // A ring of maximumEntries_ slots; the rows are the count_ slots
+    // starting at first_
+    std::vector<Log::Message> entries_;
 
-    QList<Entry> entries_;
+    std::vector<Log::Message> pending_;
+    QTimer *insertTimer_;
 };
 
 #endif // LOGMODEL_H
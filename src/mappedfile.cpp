@@ -0,0 +1,43 @@
+#include "mappedfile.h"
+#include "log.h"
+
+MappedFile::MappedFile() : data_(nullptr), size_(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        file_.unmap(data_);
+    }
+}
+
+bool MappedFile::open(const QString &path)
+{
+    file_.setFileName(path);
+    if (!file_.open(QFile::ReadOnly))
+    {
+        Log::error(QString("Failed to open file: ") + file_.errorString());
+        return false;
+    }
+
+    qint64 size = file_.size();
+    if (size <= 0)
+    {
+        Log::error("Failed to map file: file is empty");
+        return false;
+    }
+
+    data_ = file_.map(0, size);
+    if (data_ == nullptr)
+    {
+        Log::error(QString("Failed to map file: ") + file_.errorString());
+        return false;
+    }
+
+    path_ = path;
+    size_ = static_cast<size_t>(size);
+
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <memory>
+
+/* A read-only memory mapping of an entire file. Sections and other
+ * views into the file point directly into the mapping and hold a
+ * MappedFilePtr to keep it alive. */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /* Maps the file at path. Returns true on success */
+    bool open(const QString &path);
+
+    inline bool valid() const
+    {
+        return data_ != nullptr;
+    }
+
+    inline const char *data() const
+    {
+        return reinterpret_cast<const char *>(data_);
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    // Returns the file descriptor of the mapped file
+    inline int handle() const
+    {
+        return file_.handle();
+    }
+
+    inline const QString &path() const
+    {
+        return path_;
+    }
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    QFile file_;
+    QString path_;
+    uchar *data_;
+    size_t size_;
+};
+
+typedef std::shared_ptr<MappedFile> MappedFilePtr;
+
+#endif // MAPPEDFILE_H
@@ -1,48 +1,43 @@
 #include "cofffile.h"
+#include "arch/architecturex86.h"
 #include "log.h"
 #include "pesection.h"
-#include <QDataStream>
+#include <cstring>
 #include <time.h>
 
 // These constants include the optional header extension
 static const uint32_t OPTHEADER_SIZE_BASE_PE32 = 96;
 static const uint32_t OPTHEADER_SIZE_BASE_PE32P = 112;
 
+static const uint32_t COFFHEADER_SIZE = 20;
+static const uint32_t DATADIRECTORY_SIZE = 8;
+static const uint32_t RUNTIMEFUNCTION_SIZE = 12;
+static const uint8_t UNW_FLAG_CHAININFO = 0x4;
+static const uint32_t SECTIONHEADER_SIZE = 40;
+
 CoffFile::CoffFile() : valid_(false)
 {
 }
 
-bool CoffFile::parse(QIODevice *device)
+bool CoffFile::parse(ByteSpan data, uint32_t peOffset)
 {
-    QDataStream stream(device);
-
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-
-    uint32_t peOffset;
-    stream >> peOffset;
+    size_t offset = peOffset;
 
-    device->seek(peOffset);
-
-    if (stream.atEnd())
+    // PE ID
+    if (!data.contains(offset, 4))
     {
         Log::error("Invalid PE file: stream ended");
         return false;
     }
 
-    // PE ID
-    {
-        uint32_t peId;
-        stream >> peId;
-
-        if (peId != 0x4550)
-        { // PE\0\0
-            Log::error("Invalid PE header ID");
-            return false;
-        }
+    if (data.u32(offset) != 0x4550)
+    { // PE\0\0
+        Log::error("Invalid PE header ID");
+        return false;
     }
+    offset += 4;
 
-    if (!parseCoffHeader(stream))
+    if (!parseCoffHeader(data, offset))
     {
         return false;
     }
@@ -51,13 +46,13 @@ bool CoffFile::parse(QIODevice *device)
 
     if (optionalHeaderExists_)
     {
-        if (!parseOptionalHeader(stream))
+        if (!parseOptionalHeader(data, offset))
         {
             return false;
         }
     }
 
-    if (!parseSectionTable(stream))
+    if (!parseSectionTable(data, offset))
     {
         return false;
     }
@@ -67,34 +62,40 @@ bool CoffFile::parse(QIODevice *device)
     return true;
 }
 
-bool CoffFile::parseCoffHeader(QDataStream &stream)
+bool CoffFile::parseCoffHeader(ByteSpan data, size_t &offset)
 {
-    stream >> coffHeader_.machine;
-    stream >> coffHeader_.numberOfSections;
-    stream >> coffHeader_.timeDateStamp;
-    stream >> coffHeader_.pointerToSymbolTable;
-    stream >> coffHeader_.numberOfSymbols;
-    stream >> coffHeader_.sizeOfOptionalHeader;
-    stream >> coffHeader_.characteristics;
-
-    if (stream.atEnd())
+    ByteSpan h = data.sub(offset, COFFHEADER_SIZE);
+    if (h.empty())
     {
         Log::error("Invalid PE file: stream ended");
         return false;
     }
 
+    coffHeader_.machine = h.u16(0);
+    coffHeader_.numberOfSections = h.u16(2);
+    coffHeader_.timeDateStamp = h.u32(4);
+    coffHeader_.pointerToSymbolTable = h.u32(8);
+    coffHeader_.numberOfSymbols = h.u32(12);
+    coffHeader_.sizeOfOptionalHeader = h.u16(16);
+    coffHeader_.characteristics = h.u16(18);
+
+    offset += COFFHEADER_SIZE;
     return true;
 }
 
-bool CoffFile::parseOptionalHeader(QDataStream &stream)
+bool CoffFile::parseOptionalHeader(ByteSpan data, size_t &offset)
 {
-    stream >> optionalHeader_.signature;
-    if (stream.atEnd())
+    // The whole optional header, including the data directories, is bounds
+    // checked once here
+    ByteSpan h = data.sub(offset, coffHeader_.sizeOfOptionalHeader);
+    if (h.size() < 2)
     {
         Log::error("Invalid PE file: stream ended");
         return false;
     }
 
+    optionalHeader_.signature = h.u16(0);
+
     bool pe32 = false;
 
     switch (optionalHeader_.signature)
@@ -124,84 +125,70 @@ bool CoffFile::parseOptionalHeader(QDataStream &stream)
         return false;
     }
 
-    stream >> optionalHeader_.majorLinkerVersion;
-    stream >> optionalHeader_.minorLinkerVersion;
-    stream >> optionalHeader_.sizeOfCode;
-    stream >> optionalHeader_.sizeOfInitializedData;
-    stream >> optionalHeader_.sizeOfUninitialziedData;
-    stream >> optionalHeader_.addressOfEntryPoint;
-    stream >> optionalHeader_.baseOfCode;
-
-    // A temporary variable for reading 32 bit fields for the pe32 format.
-    // We cannot read directly to the structure because some fields are 64 bit
-    // to accomodate for PE32+
-    uint32_t tempPe32;
+    optionalHeader_.majorLinkerVersion = h.u8(2);
+    optionalHeader_.minorLinkerVersion = h.u8(3);
+    optionalHeader_.sizeOfCode = h.u32(4);
+    optionalHeader_.sizeOfInitializedData = h.u32(8);
+    optionalHeader_.sizeOfUninitialziedData = h.u32(12);
+    optionalHeader_.addressOfEntryPoint = h.u32(16);
+    optionalHeader_.baseOfCode = h.u32(20);
 
+    // PE32 has an extra baseOfData field and a 32 bit imageBase, which end
+    // at the same offset as the 64 bit imageBase of PE32+
     if (pe32)
     {
-        stream >> optionalHeader_.baseOfData;
+        optionalHeader_.baseOfData = h.u32(24);
 
         // Start optional header extension
-        stream >> tempPe32;
-        optionalHeader_.imageBase = tempPe32;
+        optionalHeader_.imageBase = h.u32(28);
     }
     else
     {
-        stream >> optionalHeader_.imageBase;
-    }
-
-    stream >> optionalHeader_.sectionAlignment;
-    stream >> optionalHeader_.fileAlignment;
-    stream >> optionalHeader_.majorOperatingSystemVersion;
-    stream >> optionalHeader_.minorOperatingSystemVersion;
-    stream >> optionalHeader_.majorImageVersion;
-    stream >> optionalHeader_.minorImageVersion;
-    stream >> optionalHeader_.majorSubsystemVersion;
-    stream >> optionalHeader_.minorSubsystemVersion;
-    stream >> optionalHeader_.win32VersionValue;
-    stream >> optionalHeader_.sizeOfImage;
-    stream >> optionalHeader_.sizeOfHeaders;
-    stream >> optionalHeader_.checkSum;
-    stream >> optionalHeader_.subsystem;
-    stream >> optionalHeader_.dllCharacteristics;
-    if (pe32)
-    {
-        stream >> tempPe32;
-        optionalHeader_.sizeOfStackReserve = tempPe32;
-        stream >> tempPe32;
-        optionalHeader_.sizeOfStackCommit = tempPe32;
-        stream >> tempPe32;
-        optionalHeader_.sizeOfHeapReserve = tempPe32;
-        stream >> tempPe32;
-        optionalHeader_.sizeOfHeapCommit = tempPe32;
-    }
-    else
-    {
-        stream >> optionalHeader_.sizeOfStackReserve;
-        stream >> optionalHeader_.sizeOfStackCommit;
-        stream >> optionalHeader_.sizeOfHeapReserve;
-        stream >> optionalHeader_.sizeOfHeapCommit;
-    }
-    stream >> optionalHeader_.loaderFlags;
-    stream >> optionalHeader_.numberOfRvaAndSizes;
-
-    if (stream.atEnd())
-    {
-        Log::error("Invalid PE file: stream ended");
-        return false;
+        optionalHeader_.imageBase = h.u64(24);
     }
 
-    uint16_t sizeLeft;
+    optionalHeader_.sectionAlignment = h.u32(32);
+    optionalHeader_.fileAlignment = h.u32(36);
+    optionalHeader_.majorOperatingSystemVersion = h.u16(40);
+    optionalHeader_.minorOperatingSystemVersion = h.u16(42);
+    optionalHeader_.majorImageVersion = h.u16(44);
+    optionalHeader_.minorImageVersion = h.u16(46);
+    optionalHeader_.majorSubsystemVersion = h.u16(48);
+    optionalHeader_.minorSubsystemVersion = h.u16(50);
+    optionalHeader_.win32VersionValue = h.u32(52);
+    optionalHeader_.sizeOfImage = h.u32(56);
+    optionalHeader_.sizeOfHeaders = h.u32(60);
+    optionalHeader_.checkSum = h.u32(64);
+    optionalHeader_.subsystem = h.u16(68);
+    optionalHeader_.dllCharacteristics = h.u16(70);
+
+    uint32_t directoryOffset;
     if (pe32)
     {
-        sizeLeft = coffHeader_.sizeOfOptionalHeader - OPTHEADER_SIZE_BASE_PE32;
+        optionalHeader_.sizeOfStackReserve = h.u32(72);
+        optionalHeader_.sizeOfStackCommit = h.u32(76);
+        optionalHeader_.sizeOfHeapReserve = h.u32(80);
+        optionalHeader_.sizeOfHeapCommit = h.u32(84);
+        optionalHeader_.loaderFlags = h.u32(88);
+        optionalHeader_.numberOfRvaAndSizes = h.u32(92);
+        directoryOffset = OPTHEADER_SIZE_BASE_PE32;
     }
     else
     {
-        sizeLeft = coffHeader_.sizeOfOptionalHeader - OPTHEADER_SIZE_BASE_PE32P;
+        optionalHeader_.sizeOfStackReserve = h.u64(72);
+        optionalHeader_.sizeOfStackCommit = h.u64(80);
+        optionalHeader_.sizeOfHeapReserve = h.u64(88);
+        optionalHeader_.sizeOfHeapCommit = h.u64(96);
+        optionalHeader_.loaderFlags = h.u32(104);
+        optionalHeader_.numberOfRvaAndSizes = h.u32(108);
+        directoryOffset = OPTHEADER_SIZE_BASE_PE32P;
     }
 
-    uint16_t sizeNeeded = optionalHeader_.numberOfRvaAndSizes * 8; // 2 dwords
+    uint32_t sizeLeft = coffHeader_.sizeOfOptionalHeader - directoryOffset;
+
+    uint64_t sizeNeeded = static_cast<uint64_t>(
+                              optionalHeader_.numberOfRvaAndSizes) *
+                          DATADIRECTORY_SIZE; // 2 dwords
     if (sizeLeft < sizeNeeded)
     {
         Log::error("Invalid PE file: data-directory entries exceed optional "
@@ -209,12 +196,13 @@ bool CoffFile::parseOptionalHeader(QDataStream &stream)
         return false;
     }
 
+    dataDirectories_.resize(optionalHeader_.numberOfRvaAndSizes);
     for (uint32_t i = 0; i < optionalHeader_.numberOfRvaAndSizes; ++i)
     {
-        DataDirectory dataDirectory;
-        stream >> dataDirectory.virtualAddress;
-        stream >> dataDirectory.size;
-        dataDirectories_.push_back(dataDirectory);
+        DataDirectory &dataDirectory = dataDirectories_[i];
+        dataDirectory.virtualAddress = h.u32(directoryOffset);
+        dataDirectory.size = h.u32(directoryOffset + 4);
+        directoryOffset += DATADIRECTORY_SIZE;
     }
 
     sizeLeft -= sizeNeeded;
@@ -224,67 +212,85 @@ bool CoffFile::parseOptionalHeader(QDataStream &stream)
             QString("There are %1 excess bytes in the optional header; "
                     "skipping over them")
                 .arg(sizeLeft));
-        stream.skipRawData(sizeLeft);
     }
 
-    if (stream.atEnd())
+    offset += coffHeader_.sizeOfOptionalHeader;
+    return true;
+}
+
+bool CoffFile::parseSectionTable(ByteSpan data, size_t &offset)
+{
+    ByteSpan table = data.sub(
+        offset, static_cast<size_t>(coffHeader_.numberOfSections) *
+                    SECTIONHEADER_SIZE);
+    if (table.empty() && coffHeader_.numberOfSections != 0)
     {
         Log::error("Invalid PE file: stream ended");
         return false;
     }
 
+    sectionTable_.resize(coffHeader_.numberOfSections);
+    for (uint16_t i = 0; i < coffHeader_.numberOfSections; ++i)
+    {
+        SectionHeader &header = sectionTable_[i];
+        ByteSpan h = table.sub(i * SECTIONHEADER_SIZE, SECTIONHEADER_SIZE);
+
+        memcpy(header.name, h.data(), 8);
+        header.name[8] = '\0';
+        header.virtualSize = h.u32(8);
+        header.virtualAddress = h.u32(12);
+        header.sizeOfRawData = h.u32(16);
+        header.pointerToRawData = h.u32(20);
+        header.pointerToRelocations = h.u32(24);
+        header.pointerToLineNumbers = h.u32(28);
+        header.numberOfRelocations = h.u16(32);
+        header.numberOfLineNumbers = h.u16(34);
+        header.characteristics = h.u32(36);
+    }
+
+    offset += table.size();
     return true;
 }
 
-bool CoffFile::parseSectionTable(QDataStream &stream)
+bool CoffFile::copySections(ByteSpan data)
 {
-    for (uint16_t i = 0; i < coffHeader_.numberOfSections; ++i)
+    for (const SectionHeader &header : sectionTable_)
     {
-        SectionHeader header;
-        header.name[8] = '\0';
-        if (stream.readRawData(header.name, 8) != 8)
+        PESectionPtr section = std::make_shared<PESection>(header);
+
+        ByteSpan raw = data.sub(header.pointerToRawData, header.sizeOfRawData);
+        if (raw.empty() && header.sizeOfRawData != 0)
         {
-            Log::error("Invalid PE file: stream ended");
+            Log::error("Invalid PE file: stream ended reading section data");
             return false;
         }
-        stream >> header.virtualSize;
-        stream >> header.virtualAddress;
-        stream >> header.sizeOfRawData;
-        stream >> header.pointerToRawData;
-        stream >> header.pointerToRelocations;
-        stream >> header.pointerToLineNumbers;
-        stream >> header.numberOfRelocations;
-        stream >> header.numberOfLineNumbers;
-        stream >> header.characteristics;
 
-        sectionTable_.push_back(header);
-    }
+        section->setRawData(std::vector<char>(raw.data(),
+                                              raw.data() + raw.size()));
 
-    if (stream.atEnd())
-    {
-        Log::error("Invalid PE file: stream ended");
-        return false;
+        sections_.push_back(std::static_pointer_cast<Section>(section));
     }
 
     return true;
 }
 
-bool CoffFile::parseSections(QDataStream &stream)
+bool CoffFile::mapSections(MappedFilePtr file)
 {
+    mapping_ = file;
+
     for (const SectionHeader &header : sectionTable_)
     {
         PESectionPtr section = std::make_shared<PESection>(header);
 
-        std::vector<char> data(header.sizeOfRawData);
-        device_->seek(header.pointerToRawData);
-        if (stream.readRawData(data.data(), header.sizeOfRawData) !=
-            header.sizeOfRawData)
+        if (header.pointerToRawData > file->size() ||
+            header.sizeOfRawData > file->size() - header.pointerToRawData)
         {
-            Log::error("Invalid PE file: stream ended reading section data");
+            Log::error("Invalid PE file: section data exceeds file size");
             return false;
         }
 
-        section->setRawData(std::move(data));
+        section->setRawData(file, file->data() + header.pointerToRawData,
+                            header.sizeOfRawData);
 
         sections_.push_back(std::static_pointer_cast<Section>(section));
     }
@@ -292,6 +298,132 @@ bool CoffFile::parseSections(QDataStream &stream)
     return true;
 }
 
+ArchitecturePtr CoffFile::createArchitecture() const
+{
+    switch (coffHeader_.machine)
+    {
+    case MACH_I386:
+        return std::make_shared<Architecturex86>(Architecturex86::BIT32);
+    case MACH_AMD64:
+        return std::make_shared<Architecturex86>(Architecturex86::BIT64);
+    default:
+        Log::error(QString("Unsupported machine type: %1")
+                       .arg(machineString(
+                           static_cast<MachineType>(coffHeader_.machine))));
+        return nullptr;
+    }
+}
+
+bool CoffFile::rvaToOffset(uint32_t rva, uint32_t &offset) const
+{
+    if (optionalHeaderExists_ && rva < optionalHeader_.sizeOfHeaders)
+    {
+        offset = rva;
+        return true;
+    }
+
+    for (const SectionHeader &header : sectionTable_)
+    {
+        if (rva >= header.virtualAddress &&
+            rva - header.virtualAddress < header.sizeOfRawData)
+        {
+            offset = header.pointerToRawData + (rva - header.virtualAddress);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ByteSpan CoffFile::rvaBytes(uint32_t rva, uint32_t size)
+{
+    return rvaBytes(rva).sub(0, size);
+}
+
+ByteSpan CoffFile::rvaBytes(uint32_t rva)
+{
+    // Sections are created in section table order
+    for (size_t i = 0; i < sectionTable_.size() && i < sections_.size(); ++i)
+    {
+        const SectionHeader &header = sectionTable_[i];
+        if (rva >= header.virtualAddress &&
+            rva - header.virtualAddress < sections_[i]->data().size())
+        {
+            return sections_[i]->data().sub(rva - header.virtualAddress);
+        }
+    }
+
+    return ByteSpan();
+}
+
+ByteSpan CoffFile::directoryBytes(DirectoryEntry entry)
+{
+    if (static_cast<size_t>(entry) >= dataDirectories_.size())
+    {
+        return ByteSpan();
+    }
+
+    const DataDirectory &directory = dataDirectories_[entry];
+    if (directory.virtualAddress == 0 || directory.size == 0)
+    {
+        return ByteSpan();
+    }
+    return rvaBytes(directory.virtualAddress, directory.size);
+}
+
+bool CoffFile::runtimeFunctions(std::vector<RuntimeFunction> &functions)
+{
+    functions.clear();
+
+    ByteSpan directory = directoryBytes(DIR_EXCEPTION);
+    if (directory.empty())
+    {
+        return false;
+    }
+
+    // Only x64 uses this layout. Other machines pack their entries
+    // differently
+    if (coffHeader_.machine != MACH_AMD64)
+    {
+        return false;
+    }
+
+    if (directory.size() % RUNTIMEFUNCTION_SIZE != 0)
+    {
+        Log::warning("Exception directory size is not a multiple of the "
+                     "entry size; ignoring the trailing bytes");
+    }
+
+    size_t count = directory.size() / RUNTIMEFUNCTION_SIZE;
+    functions.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t offset = i * RUNTIMEFUNCTION_SIZE;
+
+        RuntimeFunction function;
+        function.beginAddress = directory.u32(offset);
+        function.endAddress = directory.u32(offset + 4);
+        function.unwindInfo = directory.u32(offset + 8);
+        if (function.endAddress <= function.beginAddress)
+        {
+            continue;
+        }
+
+        // The high five bits of the first unwind info byte are flags.
+        // Chained entries describe a fragment of the function they chain
+        // to, not a function of their own
+        ByteSpan unwind = rvaBytes(function.unwindInfo, 1);
+        if (!unwind.empty() && ((unwind.u8(0) >> 3) & UNW_FLAG_CHAININFO))
+        {
+            continue;
+        }
+
+        functions.push_back(function);
+    }
+
+    return true;
+}
+
 const QString CoffFile::machineString(CoffFile::MachineType type)
 {
     switch (type)
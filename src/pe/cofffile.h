@@ -1,6 +1,9 @@
 #ifndef COFFFILE_H
 #define COFFFILE_H
 
+#include "arch/architecture.h"
+#include "bytespan.h"
+#include "mappedfile.h"
 #include "section.h"
 #include <QAbstractTableModel>
 #include <QIODevice>
@@ -11,7 +14,9 @@ class CoffFile
 public:
     CoffFile();
 
-    bool parse(QIODevice *device);
+    /* Parses the COFF header, optional header and section table from data.
+     * peOffset is the offset of the PE signature */
+    bool parse(ByteSpan data, uint32_t peOffset);
 
     inline bool valid()
     {
@@ -23,15 +28,39 @@ public:
         return sections_;
     }
 
+    /* Creates an architecture matching the machine type of the file.
+     * Returns null if the machine type is unsupported */
+    ArchitecturePtr createArchitecture() const;
+
+    /* Converts an RVA to a file offset using the section table. RVAs
+     * inside the headers map to themselves. Returns false if the RVA is
+     * not backed by file data */
+    bool rvaToOffset(uint32_t rva, uint32_t &offset) const;
+
+    /* Returns the file mapping the sections point into. Null when the
+     * file was parsed from a QIODevice */
+    inline MappedFilePtr mapping()
+    {
+        return mapping_;
+    }
+
 protected:
-    QIODevice *device_;
+    MappedFilePtr mapping_;
     bool valid_;
 
+    /* Creates the sections with copies of their raw data */
+    bool copySections(ByteSpan data);
+
+    /* Creates the sections as views into the mapped file. No section
+     * data is copied */
+    bool mapSections(MappedFilePtr file);
+
 private:
-    bool parseCoffHeader(QDataStream &stream);
-    bool parseOptionalHeader(QDataStream &stream);
-    bool parseSectionTable(QDataStream &stream);
-    bool parseSections(QDataStream &stream);
+    // Each parser bounds checks its structure once and advances offset
+    // past it
+    bool parseCoffHeader(ByteSpan data, size_t &offset);
+    bool parseOptionalHeader(ByteSpan data, size_t &offset);
+    bool parseSectionTable(ByteSpan data, size_t &offset);
 
 public:
     struct CoffHeader
@@ -90,6 +119,34 @@ public:
         uint32_t size;
     };
 
+    // Indices into dataDirectories_
+    enum DirectoryEntry
+    {
+        DIR_EXPORT = 0,
+        DIR_IMPORT = 1,
+        DIR_RESOURCE = 2,
+        DIR_EXCEPTION = 3,
+        DIR_SECURITY = 4,
+        DIR_BASERELOC = 5,
+        DIR_DEBUG = 6,
+        DIR_ARCHITECTURE = 7,
+        DIR_GLOBALPTR = 8,
+        DIR_TLS = 9,
+        DIR_LOAD_CONFIG = 10,
+        DIR_BOUND_IMPORT = 11,
+        DIR_IAT = 12,
+        DIR_DELAY_IMPORT = 13,
+        DIR_CLR_RUNTIME = 14,
+    };
+
+    // An entry of the x64 exception directory (.pdata)
+    struct RuntimeFunction
+    {
+        uint32_t beginAddress;
+        uint32_t endAddress;
+        uint32_t unwindInfo;
+    };
+
     struct SectionHeader
     {
         char name[9]; // 8 max chars plus null-terminator
@@ -233,6 +290,23 @@ public:
         SCHAR_MEM_WRITE = 0x80000000,
     };
 
+    /* Returns the section bytes [rva, rva + size), or an empty span unless
+     * they all lie in the data of one section */
+    ByteSpan rvaBytes(uint32_t rva, uint32_t size);
+
+    /* Returns the section bytes from rva to the end of its section data,
+     * or an empty span */
+    ByteSpan rvaBytes(uint32_t rva);
+
+    /* Returns the bytes of a data directory, or an empty span if it is
+     * absent or not backed by section data */
+    ByteSpan directoryBytes(DirectoryEntry entry);
+
+    /* Reads the function table of the exception directory, leaving out
+     * the entries for chained fragments of other functions. Returns false
+     * if the directory is absent or the file is not x64 */
+    bool runtimeFunctions(std::vector<RuntimeFunction> &functions);
+
     CoffHeader coffHeader_;
     bool optionalHeaderExists_;
     OptionalHeader optionalHeader_;
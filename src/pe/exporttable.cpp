@@ -0,0 +1,229 @@
+#include "exporttable.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+// Size of IMAGE_EXPORT_DIRECTORY
+static const uint32_t EXPORTDIRECTORY_SIZE = 40;
+
+// Names longer than this are cut off
+static const size_t MAX_NAME = 4096;
+
+// Orders names like strcmp on unsigned characters
+static bool nameLess(const char *a, size_t aLength, const char *b,
+                     size_t bLength)
+{
+    int result = memcmp(a, b, std::min(aLength, bLength));
+    return result < 0 || (result == 0 && aLength < bLength);
+}
+
+ExportTable::ExportTable()
+{
+}
+
+void ExportTable::clear()
+{
+    exports_.clear();
+    byName_.clear();
+    moduleName_ = ByteSpan();
+    sections_.clear();
+}
+
+bool ExportTable::parse(CoffFile &cofffile)
+{
+    clear();
+
+    if (cofffile.dataDirectories_.size() <= CoffFile::DIR_EXPORT)
+    {
+        return false;
+    }
+    const CoffFile::DataDirectory &directory =
+        cofffile.dataDirectories_[CoffFile::DIR_EXPORT];
+    ByteSpan header = cofffile.rvaBytes(directory.virtualAddress,
+                                        EXPORTDIRECTORY_SIZE);
+    if (directory.virtualAddress == 0 || header.empty())
+    {
+        return false;
+    }
+
+    sections_ = cofffile.sections();
+
+    uint32_t base = header.u32(16);
+    uint32_t functionCount = header.u32(20);
+    uint32_t nameCount = header.u32(24);
+
+    // Reject counts the tables cannot hold before sizing anything by them
+    ByteSpan functions = cofffile.rvaBytes(
+        header.u32(28), static_cast<uint32_t>(std::min<uint64_t>(
+                            functionCount * 4ull, 0xFFFFFFFFull)));
+    ByteSpan names = cofffile.rvaBytes(
+        header.u32(32), static_cast<uint32_t>(std::min<uint64_t>(
+                            nameCount * 4ull, 0xFFFFFFFFull)));
+    ByteSpan nameOrdinals = cofffile.rvaBytes(
+        header.u32(36), static_cast<uint32_t>(std::min<uint64_t>(
+                            nameCount * 2ull, 0xFFFFFFFFull)));
+    if ((functionCount != 0 && functions.empty()) ||
+        (nameCount != 0 && (names.empty() || nameOrdinals.empty())))
+    {
+        Log::warning("Export directory tables lie outside the sections; "
+                     "ignoring the exports");
+        clear();
+        return false;
+    }
+
+    const char *moduleName;
+    uint32_t moduleNameLength;
+    if (string(cofffile, header.u32(12), moduleName, moduleNameLength))
+    {
+        moduleName_ = ByteSpan(moduleName, moduleNameLength);
+    }
+
+    // Addresses inside the export directory are forwarder strings rather
+    // than code
+    uint32_t directoryBegin = directory.virtualAddress;
+    uint32_t directoryEnd = directory.virtualAddress + directory.size;
+
+    exports_.reserve(std::max(functionCount, nameCount));
+
+    std::vector<bool> named(functionCount, false);
+    for (uint32_t i = 0; i < nameCount; ++i)
+    {
+        uint16_t index = nameOrdinals.u16(i * 2);
+        if (index >= functionCount)
+        {
+            continue;
+        }
+
+        Export entry;
+        entry.rva = functions.u32(index * 4);
+        entry.ordinal = static_cast<uint16_t>(base + index);
+        entry.forwarder = nullptr;
+        entry.forwarderLength = 0;
+        if (entry.rva == 0 ||
+            !string(cofffile, names.u32(i * 4), entry.name, entry.nameLength))
+        {
+            continue;
+        }
+        named[index] = true;
+        exports_.push_back(entry);
+    }
+
+    for (uint32_t index = 0; index < functionCount; ++index)
+    {
+        Export entry;
+        entry.rva = functions.u32(index * 4);
+        entry.ordinal = static_cast<uint16_t>(base + index);
+        entry.name = nullptr;
+        entry.nameLength = 0;
+        entry.forwarder = nullptr;
+        entry.forwarderLength = 0;
+        if (!named[index] && entry.rva != 0)
+        {
+            exports_.push_back(entry);
+        }
+    }
+
+    for (Export &entry : exports_)
+    {
+        if (entry.rva >= directoryBegin && entry.rva < directoryEnd &&
+            string(cofffile, entry.rva, entry.forwarder,
+                   entry.forwarderLength))
+        {
+            entry.rva = 0;
+        }
+    }
+
+    // By address, with named exports before unnamed ones at the same
+    // address
+    std::sort(exports_.begin(), exports_.end(),
+              [](const Export &a, const Export &b) {
+                  if (a.rva != b.rva)
+                  {
+                      return a.rva < b.rva;
+                  }
+                  return a.name != nullptr && b.name == nullptr;
+              });
+
+    // Sorted by the bytes of the names, as the loader searches them
+    for (uint32_t i = 0; i < exports_.size(); ++i)
+    {
+        if (exports_[i].name != nullptr)
+        {
+            byName_.push_back(i);
+        }
+    }
+    std::sort(byName_.begin(), byName_.end(), [this](uint32_t a, uint32_t b) {
+        return nameLess(exports_[a].name, exports_[a].nameLength,
+                        exports_[b].name, exports_[b].nameLength);
+    });
+
+    return true;
+}
+
+size_t ExportTable::lowerBound(uint32_t rva) const
+{
+    return std::lower_bound(exports_.begin(), exports_.end(), rva,
+                            [](const Export &entry, uint32_t value) {
+                                return entry.rva < value;
+                            }) -
+           exports_.begin();
+}
+
+const ExportTable::Export *ExportTable::findRva(uint32_t rva) const
+{
+    if (rva == 0)
+    {
+        return nullptr;
+    }
+
+    size_t index = lowerBound(rva);
+    if (index == exports_.size() || exports_[index].rva != rva)
+    {
+        return nullptr;
+    }
+    return &exports_[index];
+}
+
+const ExportTable::Export *ExportTable::findName(const char *name,
+                                                 size_t length) const
+{
+    auto it = std::lower_bound(
+        byName_.begin(), byName_.end(), 0u,
+        [this, name, length](uint32_t index, uint32_t) {
+            return nameLess(exports_[index].name, exports_[index].nameLength,
+                            name, length);
+        });
+    if (it == byName_.end())
+    {
+        return nullptr;
+    }
+
+    const Export &entry = exports_[*it];
+    if (entry.nameLength != length || memcmp(entry.name, name, length) != 0)
+    {
+        return nullptr;
+    }
+    return &entry;
+}
+
+bool ExportTable::string(CoffFile &cofffile, uint32_t rva, const char *&text,
+                         uint32_t &length)
+{
+    ByteSpan data = cofffile.rvaBytes(rva);
+    if (data.empty())
+    {
+        return false;
+    }
+
+    data = data.sub(0, std::min(data.size(), MAX_NAME));
+    const void *terminator = memchr(data.data(), '\0', data.size());
+    if (terminator == nullptr)
+    {
+        return false;
+    }
+
+    text = data.data();
+    length = static_cast<uint32_t>(static_cast<const char *>(terminator) -
+                                   data.data());
+    return true;
+}
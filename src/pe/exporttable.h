@@ -0,0 +1,97 @@
+#ifndef EXPORTTABLE_H
+#define EXPORTTABLE_H
+
+#include "bytespan.h"
+#include "cofffile.h"
+#include <memory>
+#include <vector>
+
+/* The export directory of a PE file. Exports are kept sorted by RVA, with
+ * a second index sorted by name, and every lookup is a binary search.
+ *
+ * Names and forwarder strings are not copied: they point into the section
+ * data of the file, which the table keeps alive by holding the sections.
+ * Parsing a DLL with tens of thousands of exports therefore allocates two
+ * arrays and nothing per export. */
+class ExportTable
+{
+public:
+    struct Export
+    {
+        // Zero for forwarded exports, which have no code in this image
+        uint32_t rva;
+        uint16_t ordinal;
+
+        // The name, not null-terminated. Null for exports by ordinal only
+        const char *name;
+        uint32_t nameLength;
+
+        // The "module.symbol" or "module.#ordinal" an export is forwarded
+        // to, not null-terminated. Null unless the export is forwarded
+        const char *forwarder;
+        uint32_t forwarderLength;
+
+        inline bool forwarded() const
+        {
+            return forwarder != nullptr;
+        }
+    };
+
+    ExportTable();
+
+    /* Reads the export directory of cofffile. Returns false if there is
+     * none or it is malformed */
+    bool parse(CoffFile &cofffile);
+
+    void clear();
+
+    // Returns the number of exports. An export with several names is
+    // counted once per name
+    inline size_t size() const
+    {
+        return exports_.size();
+    }
+
+    // Exports in RVA order. Forwarded exports come first
+    inline const Export &operator[](size_t index) const
+    {
+        return exports_[index];
+    }
+
+    /* Returns the name of the DLL as recorded in the directory, not
+     * null-terminated */
+    inline ByteSpan moduleName() const
+    {
+        return moduleName_;
+    }
+
+    /* Returns the index of the first export at or after rva, or size() */
+    size_t lowerBound(uint32_t rva) const;
+
+    /* Returns an export at rva, preferring named ones, or null */
+    const Export *findRva(uint32_t rva) const;
+
+    /* Returns the export with a name, or null. The comparison is exact
+     * and case sensitive, as the loader's */
+    const Export *findName(const char *name, size_t length) const;
+
+private:
+    /* Points at the null-terminated string at rva. Returns false if it
+     * does not lie in the section data */
+    bool string(CoffFile &cofffile, uint32_t rva, const char *&text,
+                uint32_t &length);
+
+    std::vector<Export> exports_;
+
+    // Indices into exports_ of the named exports, sorted by name
+    std::vector<uint32_t> byName_;
+
+    ByteSpan moduleName_;
+
+    // Keeps the data the names point into alive
+    std::vector<SectionPtr> sections_;
+};
+
+typedef std::shared_ptr<ExportTable> ExportTablePtr;
+
+#endif // EXPORTTABLE_H
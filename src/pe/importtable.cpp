@@ -0,0 +1,326 @@
+#include "importtable.h"
+#include "log.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+// Sizes of IMAGE_IMPORT_DESCRIPTOR and IMAGE_DELAYLOAD_DESCRIPTOR
+static const uint32_t IMPORT_DESCRIPTOR_SIZE = 20;
+static const uint32_t DELAY_DESCRIPTOR_SIZE = 32;
+
+// Bit 0 of the delay-load attributes: the descriptor holds RVAs rather
+// than virtual addresses
+static const uint32_t DELAY_RVA_BASED = 1;
+
+// Names longer than this are cut off
+static const size_t MAX_NAME = 512;
+
+// Returns the null-terminated string at the start of data, without the
+// terminator
+static ByteSpan cString(ByteSpan data)
+{
+    data = data.sub(0, std::min(data.size(), MAX_NAME));
+    const void *terminator = memchr(data.data(), '\0', data.size());
+    if (terminator == nullptr)
+    {
+        return data;
+    }
+    return data.sub(0, static_cast<const char *>(terminator) - data.data());
+}
+
+ImportTable::ImportTable() : imageBase_(0), pe32Plus_(false), shift_(64)
+{
+}
+
+void ImportTable::clear()
+{
+    imports_.clear();
+    modules_.clear();
+    strings_.clear();
+    keys_.clear();
+    values_.clear();
+    shift_ = 64;
+}
+
+bool ImportTable::parse(CoffFile &cofffile, uint64_t base)
+{
+    clear();
+
+    if (!cofffile.optionalHeaderExists_)
+    {
+        return false;
+    }
+
+    imageBase_ = base != 0 ? base : cofffile.optionalHeader_.imageBase;
+    pe32Plus_ = cofffile.optionalHeader_.signature == CoffFile::ET_PE32P;
+
+    // The descriptor lists end with an empty descriptor, and some linkers
+    // write directory sizes that do not cover it, so only the address of
+    // each directory is used
+    std::vector<CoffFile::DataDirectory> &directories =
+        cofffile.dataDirectories_;
+    if (directories.size() > CoffFile::DIR_IMPORT &&
+        directories[CoffFile::DIR_IMPORT].virtualAddress != 0)
+    {
+        parseImports(cofffile,
+                     directories[CoffFile::DIR_IMPORT].virtualAddress);
+    }
+    if (directories.size() > CoffFile::DIR_DELAY_IMPORT &&
+        directories[CoffFile::DIR_DELAY_IMPORT].virtualAddress != 0)
+    {
+        parseDelayImports(
+            cofffile, directories[CoffFile::DIR_DELAY_IMPORT].virtualAddress);
+    }
+
+    buildMap();
+    return true;
+}
+
+void ImportTable::parseImports(CoffFile &cofffile, uint32_t directory)
+{
+    ByteSpan descriptors = cofffile.rvaBytes(directory);
+    for (size_t offset = 0;; offset += IMPORT_DESCRIPTOR_SIZE)
+    {
+        if (!descriptors.contains(offset, IMPORT_DESCRIPTOR_SIZE))
+        {
+            Log::warning("Import directory is not terminated");
+            return;
+        }
+
+        uint32_t lookupTable = descriptors.u32(offset);
+        uint32_t name = descriptors.u32(offset + 12);
+        uint32_t iat = descriptors.u32(offset + 16);
+        if (name == 0 && iat == 0)
+        {
+            return;
+        }
+
+        ByteSpan moduleName = cString(cofffile.rvaBytes(name));
+        if (moduleName.empty() || iat == 0)
+        {
+            Log::warning(QString("Skipping malformed import descriptor at "
+                                 "RVA 0x%1")
+                             .arg(directory + offset, 0, 16));
+            continue;
+        }
+
+        // Without a lookup table the names are read from the IAT itself,
+        // which is only safe while the file is unbound
+        parseModule(cofffile, moduleName, lookupTable != 0 ? lookupTable : iat,
+                    iat, 0, false);
+    }
+}
+
+void ImportTable::parseDelayImports(CoffFile &cofffile, uint32_t directory)
+{
+    ByteSpan descriptors = cofffile.rvaBytes(directory);
+    for (size_t offset = 0;; offset += DELAY_DESCRIPTOR_SIZE)
+    {
+        if (!descriptors.contains(offset, DELAY_DESCRIPTOR_SIZE))
+        {
+            Log::warning("Delay-load import directory is not terminated");
+            return;
+        }
+
+        uint32_t attributes = descriptors.u32(offset);
+        uint32_t name = descriptors.u32(offset + 4);
+        uint32_t iat = descriptors.u32(offset + 12);
+        uint32_t nameTable = descriptors.u32(offset + 16);
+        if (name == 0 && iat == 0)
+        {
+            return;
+        }
+
+        // Descriptors from old linkers hold virtual addresses at the
+        // preferred base, which only fit in the 32 bits of a PE32 image
+        uint64_t base = (attributes & DELAY_RVA_BASED)
+                            ? 0
+                            : cofffile.optionalHeader_.imageBase;
+        name = static_cast<uint32_t>(name - base);
+        iat = static_cast<uint32_t>(iat - base);
+        nameTable = static_cast<uint32_t>(nameTable - base);
+
+        ByteSpan moduleName = cString(cofffile.rvaBytes(name));
+        if (moduleName.empty() || iat == 0 || nameTable == 0)
+        {
+            Log::warning(QString("Skipping malformed delay-load import "
+                                 "descriptor at RVA 0x%1")
+                             .arg(directory + offset, 0, 16));
+            continue;
+        }
+
+        parseModule(cofffile, moduleName, nameTable, iat, base, true);
+    }
+}
+
+void ImportTable::parseModule(CoffFile &cofffile, ByteSpan moduleName,
+                              uint32_t names, uint32_t iat,
+                              uint64_t addressBase, bool delayed)
+{
+    uint32_t module = static_cast<uint32_t>(modules_.size());
+    modules_.push_back(static_cast<uint32_t>(strings_.size()));
+    appendString(moduleName.data(), moduleName.size());
+    strings_.push_back('\0');
+
+    // Symbols are shown with the module name in lower case and without its
+    // extension, as in kernel32!CreateFileW
+    char prefix[MAX_NAME + 1];
+    size_t prefixLength = moduleName.size();
+    for (size_t i = moduleName.size() - 1; i > 0; --i)
+    {
+        if (moduleName.data()[i] == '.')
+        {
+            prefixLength = i;
+            break;
+        }
+    }
+    for (size_t i = 0; i < prefixLength; ++i)
+    {
+        prefix[i] = static_cast<char>(
+            tolower(static_cast<unsigned char>(moduleName.data()[i])));
+    }
+    prefix[prefixLength++] = '!';
+
+    size_t width = pe32Plus_ ? 8 : 4;
+    uint64_t ordinalFlag = pe32Plus_ ? 0x8000000000000000ull : 0x80000000ull;
+
+    ByteSpan thunks = cofffile.rvaBytes(names);
+    for (size_t i = 0; thunks.contains(i * width, width); ++i)
+    {
+        uint64_t thunk =
+            pe32Plus_ ? thunks.u64(i * width) : thunks.u32(i * width);
+        if (thunk == 0)
+        {
+            return;
+        }
+
+        Import import;
+        import.slot = imageBase_ + iat + i * width;
+        import.module = module;
+        import.symbol = static_cast<uint32_t>(strings_.size());
+        import.delayed = delayed;
+        import.byOrdinal = (thunk & ordinalFlag) != 0;
+
+        appendString(prefix, prefixLength);
+        if (import.byOrdinal)
+        {
+            import.ordinal = static_cast<uint16_t>(thunk);
+
+            char text[8];
+            int length = snprintf(text, sizeof(text), "#%u", import.ordinal);
+            appendString(text, length);
+        }
+        else
+        {
+            // A hint followed by the name
+            ByteSpan hintName = cofffile.rvaBytes(
+                static_cast<uint32_t>(thunk - addressBase) & 0x7FFFFFFF);
+            if (hintName.size() < 2)
+            {
+                strings_.resize(import.symbol);
+                Log::warning(QString("Import %1 of %2 has an invalid name "
+                                     "address")
+                                 .arg(i)
+                                 .arg(QString::fromLatin1(
+                                     moduleName.data(), moduleName.size())));
+                continue;
+            }
+            import.ordinal = hintName.u16(0);
+
+            ByteSpan name = cString(hintName.sub(2));
+            appendString(name.data(), name.size());
+        }
+
+        import.symbolLength =
+            static_cast<uint32_t>(strings_.size() - import.symbol);
+        strings_.push_back('\0');
+        imports_.push_back(import);
+    }
+}
+
+void ImportTable::appendString(const char *text, size_t length)
+{
+    strings_.insert(strings_.end(), text, text + length);
+}
+
+// Fibonacci hashing: IAT slots are consecutive multiples of the pointer
+// size, which the multiplication spreads over the top bits
+static inline size_t bucket(uint64_t slot, unsigned shift)
+{
+    return static_cast<size_t>((slot * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+void ImportTable::buildMap()
+{
+    size_t capacity = 16;
+    unsigned bits = 4;
+    while (capacity < imports_.size() * 2)
+    {
+        capacity *= 2;
+        ++bits;
+    }
+
+    keys_.assign(capacity, 0);
+    values_.assign(capacity, 0);
+    shift_ = 64 - bits;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < imports_.size(); ++i)
+    {
+        uint64_t slot = imports_[i].slot;
+        if (slot == 0)
+        {
+            continue;
+        }
+
+        // A slot listed twice keeps its first import
+        size_t index = bucket(slot, shift_);
+        while (keys_[index] != 0 && keys_[index] != slot)
+        {
+            index = (index + 1) & mask;
+        }
+        if (keys_[index] == 0)
+        {
+            keys_[index] = slot;
+            values_[index] = static_cast<uint32_t>(i);
+        }
+    }
+}
+
+const ImportTable::Import *ImportTable::find(uint64_t slot) const
+{
+    if (keys_.empty() || slot == 0)
+    {
+        return nullptr;
+    }
+
+    // The table is at most half full, so every probe sequence reaches an
+    // empty bucket
+    size_t mask = keys_.size() - 1;
+    for (size_t index = bucket(slot, shift_);; index = (index + 1) & mask)
+    {
+        if (keys_[index] == slot)
+        {
+            return &imports_[values_[index]];
+        }
+        if (keys_[index] == 0)
+        {
+            return nullptr;
+        }
+    }
+}
+
+bool ImportTable::symbolAt(uint64_t address, const char *&name,
+                           std::size_t &length) const
+{
+    const Import *import = find(address);
+    if (import == nullptr)
+    {
+        return false;
+    }
+
+    name = symbolName(*import);
+    length = import->symbolLength;
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef IMPORTTABLE_H
+#define IMPORTTABLE_H
+
+#include "arch/symbolresolver.h"
+#include "bytespan.h"
+#include "cofffile.h"
+#include <memory>
+#include <vector>
+
+/* The regular and delay-load imports of a PE file. Every import is keyed
+ * by the address of its IAT slot, the one code calls or jumps through, in
+ * an open-addressing hash table built once after parsing, so naming an
+ * operand such as [0x140003010] as kernel32!CreateFileW costs one probe
+ * sequence and no allocation.
+ *
+ * All names live in one string pool: the parser appends each module name
+ * and "module!symbol" display string to it, so entries hold offsets and
+ * the table makes a handful of allocations however many imports there
+ * are. */
+class ImportTable : public SymbolResolver
+{
+public:
+    struct Import
+    {
+        // Address of the IAT slot the loader writes the import to
+        uint64_t slot;
+
+        // Index of the module in moduleName()
+        uint32_t module;
+
+        // Offset of the null-terminated "module!name" display string in
+        // the pool and its length
+        uint32_t symbol;
+        uint32_t symbolLength;
+
+        // The ordinal for imports by ordinal, otherwise the name hint
+        uint16_t ordinal;
+        bool byOrdinal;
+        bool delayed;
+    };
+
+    ImportTable();
+
+    /* Reads the import and delay-load import directories of cofffile.
+     * Slots are keyed by their address with the image loaded at base, or
+     * at its preferred base if base is 0. Returns false if it has no
+     * optional header. Malformed descriptors are skipped with a warning */
+    bool parse(CoffFile &cofffile, uint64_t base = 0);
+
+    void clear();
+
+    inline size_t size() const
+    {
+        return imports_.size();
+    }
+
+    inline const Import &operator[](size_t index) const
+    {
+        return imports_[index];
+    }
+
+    inline size_t moduleCount() const
+    {
+        return modules_.size();
+    }
+
+    // Returns the file name of a module as it appears in the descriptor
+    inline const char *moduleName(uint32_t module) const
+    {
+        return strings_.data() + modules_[module];
+    }
+
+    // Returns the "module!name" or "module!#ordinal" string of an import
+    inline const char *symbolName(const Import &import) const
+    {
+        return strings_.data() + import.symbol;
+    }
+
+    /* Returns the import whose IAT slot is at address, or null */
+    const Import *find(uint64_t slot) const;
+
+    bool symbolAt(uint64_t address, const char *&name,
+                  std::size_t &length) const override;
+
+private:
+    void parseImports(CoffFile &cofffile, uint32_t directory);
+    void parseDelayImports(CoffFile &cofffile, uint32_t directory);
+
+    /* Adds a module and its imports. names is the RVA of the thunks
+     * naming the imports and iat the RVA of the first slot. Name thunks
+     * hold addressBase + RVA */
+    void parseModule(CoffFile &cofffile, ByteSpan moduleName, uint32_t names,
+                     uint32_t iat, uint64_t addressBase, bool delayed);
+
+    // Appends text to the pool without a terminator
+    void appendString(const char *text, size_t length);
+
+    void buildMap();
+
+    // The base the slot addresses are computed from
+    uint64_t imageBase_;
+    bool pe32Plus_;
+
+    std::vector<Import> imports_;
+    std::vector<uint32_t> modules_;
+    std::vector<char> strings_;
+
+    // Open-addressing table from slot address to index in imports_ with
+    // linear probing. Its capacity is a power of two at least twice the
+    // import count; slot address 0 marks an empty bucket
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> values_;
+    unsigned shift_;
+};
+
+typedef std::shared_ptr<ImportTable> ImportTablePtr;
+
+#endif // IMPORTTABLE_H
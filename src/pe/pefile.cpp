@@ -1,7 +1,6 @@
 #include "pefile.h"
 #include "log.h"
 #include "pesection.h"
-#include <QDataStream>
 #include <time.h>
 
 
@@ -9,38 +8,48 @@ PEFile::PEFile()
 {
 }
 
-bool PEFile::parse(QIODevice *device)
+bool PEFile::parse(ByteSpan data)
 {
-    QDataStream stream(device);
-
-    stream.setByteOrder(QDataStream::LittleEndian);
-
+    if (!data.contains(0, 0x40))
     {
-        char dosId[2];
-        if (stream.readRawData(dosId, 2) != 2)
-        {
-            Log::error("PE file is too short");
-            return false;
-        }
+        Log::error("PE file is too short");
+        return false;
+    }
 
-        if (memcmp("MZ", dosId, 2) != 0)
-        {
-            Log::error("Invalid DOS header ID");
-            return false;
-        }
+    if (memcmp("MZ", data.data(), 2) != 0)
+    {
+        Log::error("Invalid DOS header ID");
+        return false;
     }
 
     // We don't care about the DOS header so we'll skip it (unless we add DOS
     // support?) The offset to the PE section is at 0x3C
-    device->seek(0x3C);
+    return CoffFile::parse(data, data.u32(0x3C));
+}
+
+bool PEFile::parse(QIODevice *device)
+{
+    // The whole device is read into memory and the sections hold copies of
+    // their data. Use the MappedFile overload to avoid both copies
+    QByteArray bytes = device->readAll();
+    ByteSpan data(bytes.constData(), bytes.size());
 
-    if (stream.atEnd())
+    if (!parse(data))
+    {
+        return false;
+    }
+
+    return copySections(data);
+}
+
+bool PEFile::parse(MappedFilePtr file)
+{
+    if (!parse(ByteSpan(file->data(), file->size())))
     {
-        Log::error("Invalid PE file: stream ended");
         return false;
     }
 
-    return CoffFile::parse(device);
+    return mapSections(file);
 }
 
 const char *coffFields[] = {
@@ -12,7 +12,16 @@ class PEFile : public CoffFile
 public:
     PEFile();
 
+    /* Parses the headers from a contiguous buffer holding the file */
+    bool parse(ByteSpan data);
+
+    /* Reads the whole device and parses it. Sections hold copies of
+     * their data */
     bool parse(QIODevice *device);
+
+    /* Parses a memory mapped PE file. Sections are views into the
+     * mapping and share ownership of it */
+    bool parse(MappedFilePtr file);
 };
 
 typedef std::shared_ptr<PEFile> PEFilePtr;
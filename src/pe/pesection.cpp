@@ -1,6 +1,8 @@
 #include "pesection.h"
+#include <algorithm>
 
-PESection::PESection(const PEFile::SectionHeader &header) : header_(header)
+PESection::PESection(const PEFile::SectionHeader &header)
+    : rawData_(nullptr), rawSize_(0), header_(header)
 {
 }
 
@@ -21,12 +23,42 @@ bool PESection::writable() const
 
 void PESection::setRawData(std::vector<char> &&data)
 {
-    rawData_ = std::move(data);
+    mapping_.reset();
+    owner_.reset();
+    ownedData_ = std::move(data);
+    rawData_ = ownedData_.data();
+    rawSize_ = ownedData_.size();
 }
 
 void PESection::setRawData(const std::vector<char> &data)
 {
+    mapping_.reset();
+    owner_.reset();
+    ownedData_ = data;
+    rawData_ = ownedData_.data();
+    rawSize_ = ownedData_.size();
+}
+
+void PESection::setRawData(MappedFilePtr file, const char *data,
+                           uint32_t size)
+{
+    ownedData_.clear();
+    ownedData_.shrink_to_fit();
+    mapping_ = file;
+    owner_.reset();
+    rawData_ = data;
+    rawSize_ = size;
+}
+
+void PESection::setRawData(std::shared_ptr<const void> owner,
+                           const char *data, uint32_t size)
+{
+    ownedData_.clear();
+    ownedData_.shrink_to_fit();
+    mapping_.reset();
+    owner_ = owner;
     rawData_ = data;
+    rawSize_ = size;
 }
 
 uint32_t PESection::offset()
@@ -38,3 +70,21 @@ uint32_t PESection::size()
 {
     return header_.virtualSize;
 }
+
+uint32_t PESection::fileOffset()
+{
+    return header_.pointerToRawData;
+}
+
+ByteSpan PESection::data()
+{
+    // The raw data is padded to the file alignment, so only the part
+    // covered by the virtual size belongs to the section. Some linkers
+    // leave the virtual size as zero
+    uint32_t size = rawSize_;
+    if (header_.virtualSize != 0)
+    {
+        size = std::min(size, header_.virtualSize);
+    }
+    return ByteSpan(rawData_, size);
+}
@@ -1,6 +1,7 @@
 #ifndef PESECTION_H
 #define PESECTION_H
 
+#include "mappedfile.h"
 #include "pefile.h"
 #include "section.h"
 #include <vector>
@@ -17,11 +18,41 @@ public:
     void setRawData(std::vector<char> &&data);
     void setRawData(const std::vector<char> &data);
 
+    /* Sets the raw data to a view into a mapped file. The section keeps
+     * a reference to the mapping */
+    void setRawData(MappedFilePtr file, const char *data, uint32_t size);
+
+    /* Sets the raw data to a view into memory owned by owner, e.g. a
+     * VirtualImage. The section keeps owner alive */
+    void setRawData(std::shared_ptr<const void> owner, const char *data,
+                    uint32_t size);
+
+    // Returns a pointer to the raw data of the section
+    inline const char *rawData() const
+    {
+        return rawData_;
+    }
+
+    // Returns the size of the raw data. This may be less than size()
+    inline uint32_t rawSize() const
+    {
+        return rawSize_;
+    }
+
     uint32_t offset() override;
     uint32_t size() override;
+    uint32_t fileOffset() override;
+    ByteSpan data() override;
 
 private:
-    std::vector<char> rawData_;
+    const char *rawData_;
+    uint32_t rawSize_;
+
+    // Backing storage when the data was copied rather than mapped
+    std::vector<char> ownedData_;
+    MappedFilePtr mapping_;
+    std::shared_ptr<const void> owner_;
+
     PEFile::SectionHeader header_;
 };
 
@@ -0,0 +1,232 @@
+#include "relocationtable.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+// Size of IMAGE_BASE_RELOCATION
+static const uint32_t BLOCK_HEADER_SIZE = 8;
+
+RelocationTable::RelocationTable() : extent_(0)
+{
+}
+
+void RelocationTable::clear()
+{
+    highLow_.clear();
+    dir64_.clear();
+    adjustments_.clear();
+    bitmap_.clear();
+    extent_ = 0;
+}
+
+bool RelocationTable::parse(CoffFile &cofffile)
+{
+    clear();
+
+    if (!cofffile.optionalHeaderExists_)
+    {
+        return false;
+    }
+
+    uint32_t imageSize = cofffile.optionalHeader_.sizeOfImage;
+
+    ByteSpan directory = cofffile.directoryBytes(CoffFile::DIR_BASERELOC);
+    size_t skipped = 0;
+    size_t offset = 0;
+    while (directory.contains(offset, BLOCK_HEADER_SIZE))
+    {
+        uint32_t page = directory.u32(offset);
+        uint32_t blockSize = directory.u32(offset + 4);
+        if (blockSize < BLOCK_HEADER_SIZE ||
+            !directory.contains(offset, blockSize))
+        {
+            Log::warning(QString("Relocation block at offset 0x%1 has an "
+                                 "invalid size; ignoring the rest")
+                             .arg(offset, 0, 16));
+            break;
+        }
+
+        size_t count = (blockSize - BLOCK_HEADER_SIZE) / 2;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint16_t entry = directory.u16(offset + BLOCK_HEADER_SIZE + i * 2);
+            uint16_t type = entry >> 12;
+            uint64_t rva = static_cast<uint64_t>(page) + (entry & 0xFFF);
+
+            uint32_t width;
+            switch (type)
+            {
+            case TYPE_ABSOLUTE:
+                continue;
+            case TYPE_HIGHLOW:
+                width = 4;
+                break;
+            case TYPE_DIR64:
+                width = 8;
+                break;
+            case TYPE_HIGH:
+            case TYPE_LOW:
+            case TYPE_HIGHADJ:
+                width = 2;
+                break;
+            default:
+                ++skipped;
+                continue;
+            }
+
+            // The low half of a HIGHADJ address is stored in the next
+            // entry
+            uint16_t low = 0;
+            if (type == TYPE_HIGHADJ)
+            {
+                if (++i == count)
+                {
+                    ++skipped;
+                    break;
+                }
+                low = directory.u16(offset + BLOCK_HEADER_SIZE + i * 2);
+            }
+
+            if (rva + width > imageSize)
+            {
+                ++skipped;
+                continue;
+            }
+
+            uint32_t fixup = static_cast<uint32_t>(rva);
+            extent_ = std::max(extent_, static_cast<uint32_t>(rva + width));
+            if (type == TYPE_HIGHLOW)
+            {
+                highLow_.push_back(fixup);
+            }
+            else if (type == TYPE_DIR64)
+            {
+                dir64_.push_back(fixup);
+            }
+            else
+            {
+                Adjustment adjustment;
+                adjustment.rva = fixup;
+                adjustment.type = type;
+                adjustment.low = low;
+                adjustments_.push_back(adjustment);
+            }
+        }
+
+        offset += blockSize;
+    }
+    buildBitmap();
+
+    if (skipped != 0)
+    {
+        Log::warning(QString("Skipped %1 relocations of unknown types or "
+                             "outside the image")
+                         .arg(skipped));
+    }
+
+    return true;
+}
+
+void RelocationTable::buildBitmap()
+{
+    // Sized after parsing, so a header claiming a huge image costs
+    // nothing when its fixups do not reach that far
+    bitmap_.assign((static_cast<size_t>(extent_) + 63) / 64, 0);
+
+    auto mark = [this](uint32_t rva) { bitmap_[rva >> 6] |= 1ull << (rva & 63); };
+    for (uint32_t rva : highLow_)
+    {
+        mark(rva);
+    }
+    for (uint32_t rva : dir64_)
+    {
+        mark(rva);
+    }
+    for (const Adjustment &adjustment : adjustments_)
+    {
+        mark(adjustment.rva);
+    }
+}
+
+bool RelocationTable::any(uint32_t rva, uint32_t size) const
+{
+    uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(rva) + size,
+                                      extent_);
+
+    // A word of the bitmap at a time
+    for (uint64_t bit = rva; bit < end;)
+    {
+        unsigned shift = bit & 63;
+        uint64_t count = std::min<uint64_t>(64 - shift, end - bit);
+        uint64_t bits = bitmap_[bit >> 6] >> shift;
+        if (count < 64)
+        {
+            bits &= (1ull << count) - 1;
+        }
+        if (bits != 0)
+        {
+            return true;
+        }
+        bit += count;
+    }
+
+    return false;
+}
+
+bool RelocationTable::apply(char *image, size_t size, uint64_t delta) const
+{
+    if (size < extent_)
+    {
+        Log::error("Cannot apply relocations: the image ends before the "
+                   "last of them");
+        return false;
+    }
+
+    // Every fixup ends at or before extent_, so the loops need no bounds
+    // checks. memcpy keeps unaligned fixups
+    // defined and compiles to a plain load and store
+    uint32_t delta32 = static_cast<uint32_t>(delta);
+    for (uint32_t rva : highLow_)
+    {
+        uint32_t value;
+        memcpy(&value, image + rva, sizeof(value));
+        value += delta32;
+        memcpy(image + rva, &value, sizeof(value));
+    }
+
+    for (uint32_t rva : dir64_)
+    {
+        uint64_t value;
+        memcpy(&value, image + rva, sizeof(value));
+        value += delta;
+        memcpy(image + rva, &value, sizeof(value));
+    }
+
+    for (const Adjustment &adjustment : adjustments_)
+    {
+        uint16_t value;
+        memcpy(&value, image + adjustment.rva, sizeof(value));
+        switch (adjustment.type)
+        {
+        case TYPE_HIGH:
+            value += static_cast<uint16_t>(delta32 >> 16);
+            break;
+        case TYPE_LOW:
+            value += static_cast<uint16_t>(delta32);
+            break;
+        case TYPE_HIGHADJ:
+        {
+            // Adjusts the high half of the full 32-bit address, rounding
+            // for the sign of the low half
+            uint32_t address = (static_cast<uint32_t>(value) << 16) +
+                               static_cast<int16_t>(adjustment.low);
+            address += delta32 + 0x8000;
+            value = static_cast<uint16_t>(address >> 16);
+            break;
+        }
+        }
+        memcpy(image + adjustment.rva, &value, sizeof(value));
+    }
+
+    return true;
+}
@@ -0,0 +1,102 @@
+#ifndef RELOCATIONTABLE_H
+#define RELOCATIONTABLE_H
+
+#include "cofffile.h"
+#include <memory>
+#include <vector>
+
+/* The base relocations of a PE file: the places in the image that hold
+ * absolute addresses and must be adjusted when it is loaded anywhere but
+ * its preferred base.
+ *
+ * Fixups are grouped by type into plain RVA arrays, so applying them is
+ * one branch-free loop per type instead of a switch per entry. Their
+ * positions are also kept as a bitmap with one bit per byte up to the end
+ * of the last fixup, which answers whether a value at some RVA is a
+ * relocated pointer in constant time. */
+class RelocationTable
+{
+public:
+    enum Type
+    {
+        TYPE_ABSOLUTE = 0, // padding
+        TYPE_HIGH = 1,
+        TYPE_LOW = 2,
+        TYPE_HIGHLOW = 3,
+        TYPE_HIGHADJ = 4, // takes the next entry as a parameter
+        TYPE_DIR64 = 10,
+    };
+
+    RelocationTable();
+
+    /* Reads the base relocation directory of cofffile. Returns false if
+     * it has no optional header. Fixups of unknown types or outside the
+     * image are skipped with a warning */
+    bool parse(CoffFile &cofffile);
+
+    void clear();
+
+    // Returns the number of fixups
+    inline size_t size() const
+    {
+        return highLow_.size() + dir64_.size() + adjustments_.size();
+    }
+
+    inline bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // RVAs of the 32-bit fixups in block order
+    inline const std::vector<uint32_t> &highLow() const
+    {
+        return highLow_;
+    }
+
+    // RVAs of the 64-bit fixups in block order
+    inline const std::vector<uint32_t> &dir64() const
+    {
+        return dir64_;
+    }
+
+    // Returns true if a fixup starts at rva
+    inline bool contains(uint32_t rva) const
+    {
+        return rva < extent_ && (bitmap_[rva >> 6] >> (rva & 63)) & 1;
+    }
+
+    /* Returns true if a fixup starts in [rva, rva + size), e.g. in the
+     * bytes of an instruction */
+    bool any(uint32_t rva, uint32_t size) const;
+
+    /* Adds delta to every fixup in image, which must be laid out by RVA.
+     * Returns false if it ends before the last fixup */
+    bool apply(char *image, size_t size, uint64_t delta) const;
+
+private:
+    // Fixups of the 16-bit types, which only old images use
+    struct Adjustment
+    {
+        uint32_t rva;
+        uint16_t type;
+
+        // The low half of the address for TYPE_HIGHADJ
+        uint16_t low;
+    };
+
+    // Sizes the bitmap to extent_ and sets the bit of every fixup
+    void buildBitmap();
+
+    std::vector<uint32_t> highLow_;
+    std::vector<uint32_t> dir64_;
+    std::vector<Adjustment> adjustments_;
+
+    // One past the last byte of any fixup, which is the size of the
+    // image the table can be applied to and the range of the bitmap
+    uint32_t extent_;
+    std::vector<uint64_t> bitmap_;
+};
+
+typedef std::shared_ptr<RelocationTable> RelocationTablePtr;
+
+#endif // RELOCATIONTABLE_H
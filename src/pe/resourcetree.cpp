@@ -0,0 +1,219 @@
+#include "resourcetree.h"
+#include "log.h"
+#include <unordered_set>
+
+// Sizes of IMAGE_RESOURCE_DIRECTORY, IMAGE_RESOURCE_DIRECTORY_ENTRY and
+// IMAGE_RESOURCE_DATA_ENTRY
+static const uint32_t RESOURCEDIRECTORY_SIZE = 16;
+static const uint32_t RESOURCEENTRY_SIZE = 8;
+static const uint32_t RESOURCEDATA_SIZE = 16;
+
+// Set in an entry's name for named entries and in its offset for
+// subdirectories
+static const uint32_t RESOURCE_HIGH_BIT = 0x80000000;
+
+// Directory levels below the root that are followed. Real trees have
+// three
+static const uint16_t MAX_DEPTH = 8;
+
+ResourceTree::ResourceTree() : leafCount_(0)
+{
+}
+
+void ResourceTree::clear()
+{
+    mapping_ = nullptr;
+    sections_.clear();
+    directory_ = ByteSpan();
+    nodes_.clear();
+    leafCount_ = 0;
+}
+
+bool ResourceTree::parse(CoffFile &cofffile)
+{
+    clear();
+
+    if (cofffile.dataDirectories_.size() <= CoffFile::DIR_RESOURCE ||
+        cofffile.dataDirectories_[CoffFile::DIR_RESOURCE].virtualAddress == 0)
+    {
+        return false;
+    }
+
+    // Offsets in the tree are relative to the start of the directory and
+    // may point past its recorded size, so the rest of the section is kept
+    directory_ = cofffile.rvaBytes(
+        cofffile.dataDirectories_[CoffFile::DIR_RESOURCE].virtualAddress);
+    if (!directory_.contains(0, RESOURCEDIRECTORY_SIZE))
+    {
+        Log::warning("Resource directory is not backed by section data");
+        directory_ = ByteSpan();
+        return false;
+    }
+
+    mapping_ = cofffile.mapping();
+    sections_ = cofffile.sections();
+
+    Node root = Node();
+    nodes_.push_back(root);
+
+    // Breadth first, so the children of each directory are contiguous.
+    // Each directory is read once even if several entries point to it
+    std::vector<std::pair<uint32_t, uint32_t>> queue;
+    queue.push_back(std::make_pair(0u, 0u));
+    std::unordered_set<uint32_t> visited;
+    visited.insert(0);
+
+    bool malformed = false;
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        uint32_t offset = queue[q].first;
+        uint32_t parent = queue[q].second;
+        if (!directory_.contains(offset, RESOURCEDIRECTORY_SIZE))
+        {
+            malformed = true;
+            continue;
+        }
+
+        uint32_t count = static_cast<uint32_t>(directory_.u16(offset + 12)) +
+                         directory_.u16(offset + 14);
+        uint32_t entries = offset + RESOURCEDIRECTORY_SIZE;
+        if (!directory_.contains(entries, count * RESOURCEENTRY_SIZE))
+        {
+            malformed = true;
+            continue;
+        }
+
+        uint16_t depth = nodes_[parent].depth + 1;
+        nodes_[parent].first = static_cast<uint32_t>(nodes_.size());
+        nodes_[parent].count = count;
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t name = directory_.u32(entries + i * RESOURCEENTRY_SIZE);
+            uint32_t target =
+                directory_.u32(entries + i * RESOURCEENTRY_SIZE + 4);
+
+            Node node = Node();
+            node.id = name & ~RESOURCE_HIGH_BIT;
+            node.flags = (name & RESOURCE_HIGH_BIT) ? NODE_NAMED : 0;
+            node.depth = depth;
+
+            if (target & RESOURCE_HIGH_BIT)
+            {
+                uint32_t subdirectory = target & ~RESOURCE_HIGH_BIT;
+                if (depth < MAX_DEPTH && visited.insert(subdirectory).second)
+                {
+                    queue.push_back(std::make_pair(
+                        subdirectory, static_cast<uint32_t>(nodes_.size())));
+                }
+                else
+                {
+                    malformed = true;
+                }
+            }
+            else if (directory_.contains(target, RESOURCEDATA_SIZE))
+            {
+                node.flags |= NODE_LEAF;
+                node.dataRva = directory_.u32(target);
+                node.dataSize = directory_.u32(target + 4);
+                node.codePage = directory_.u32(target + 8);
+
+                // Only the headers are consulted here, not the payload
+                uint32_t last;
+                if (node.dataSize != 0 &&
+                    cofffile.rvaToOffset(node.dataRva, node.fileOffset) &&
+                    cofffile.rvaToOffset(node.dataRva + node.dataSize - 1,
+                                         last) &&
+                    last - node.fileOffset == node.dataSize - 1)
+                {
+                    node.flags |= NODE_IN_FILE;
+                }
+                ++leafCount_;
+            }
+            else
+            {
+                malformed = true;
+            }
+
+            nodes_.push_back(node);
+        }
+    }
+
+    if (malformed)
+    {
+        Log::warning("Resource directory is malformed; some resources are "
+                     "missing");
+    }
+
+    return true;
+}
+
+QString ResourceTree::name(const Node &node) const
+{
+    if (!node.named())
+    {
+        QString type = node.depth == 1 ? typeName(node.id) : QString();
+        return type.isEmpty() ? QStringLiteral("#%1").arg(node.id) : type;
+    }
+
+    // A length in characters followed by UTF-16LE text
+    if (!directory_.contains(node.id, 2))
+    {
+        return QString();
+    }
+    uint16_t length = directory_.u16(node.id);
+    ByteSpan text = directory_.sub(node.id + 2, length * 2u);
+
+    QString name;
+    name.reserve(text.size() / 2);
+    for (size_t i = 0; i + 1 < text.size(); i += 2)
+    {
+        name.append(QChar(text.u16(i)));
+    }
+    return name;
+}
+
+ByteSpan ResourceTree::data(const Node &node) const
+{
+    if (!(node.flags & NODE_IN_FILE))
+    {
+        return ByteSpan();
+    }
+
+    if (mapping_)
+    {
+        return ByteSpan(mapping_->data(), mapping_->size())
+            .sub(node.fileOffset, node.dataSize);
+    }
+
+    // Files parsed without a mapping hold copies of their sections
+    for (const SectionPtr &section : sections_)
+    {
+        if (node.dataRva >= section->offset() &&
+            node.dataRva - section->offset() < section->data().size())
+        {
+            return section->data().sub(node.dataRva - section->offset(),
+                                       node.dataSize);
+        }
+    }
+    return ByteSpan();
+}
+
+QString ResourceTree::typeName(uint32_t id)
+{
+    static const char *const names[] = {
+        nullptr,     "CURSOR",       "BITMAP",      "ICON",
+        "MENU",      "DIALOG",       "STRING",      "FONTDIR",
+        "FONT",      "ACCELERATOR",  "RCDATA",      "MESSAGETABLE",
+        "GROUP_CURSOR", nullptr,     "GROUP_ICON",  nullptr,
+        "VERSION",   "DLGINCLUDE",   nullptr,       "PLUGPLAY",
+        "VXD",       "ANICURSOR",    "ANIICON",     "HTML",
+        "MANIFEST",
+    };
+
+    if (id >= sizeof(names) / sizeof(names[0]) || names[id] == nullptr)
+    {
+        return QString();
+    }
+    return QString::fromLatin1(names[id]);
+}
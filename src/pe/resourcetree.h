@@ -0,0 +1,121 @@
+#ifndef RESOURCETREE_H
+#define RESOURCETREE_H
+
+#include "bytespan.h"
+#include "cofffile.h"
+#include <QString>
+#include <memory>
+#include <vector>
+
+/* The resource directory of a PE file as a flat array of nodes, usually
+ * three levels deep: type, name and language. The children of a directory
+ * are contiguous, so the tree is walked by index without pointers.
+ *
+ * Parsing reads only the directory tables. Leaves record where their
+ * payload lies in the file and names are decoded when asked for, so
+ * listing the resources of a large installer touches a few pages of the
+ * mapping rather than the payloads. */
+class ResourceTree
+{
+public:
+    enum NodeFlags
+    {
+        NODE_NAMED = 1,
+        NODE_LEAF = 2,
+        // The whole payload of a leaf is backed by file data
+        NODE_IN_FILE = 4,
+    };
+
+    struct Node
+    {
+        // The integer id, or the offset of the name in the directory when
+        // the node is named
+        uint32_t id;
+        uint16_t flags;
+        uint16_t depth;
+
+        // Directories: the children are nodes [first, first + count)
+        uint32_t first;
+        uint32_t count;
+
+        // Leaves: the payload. fileOffset is only set with NODE_IN_FILE
+        uint32_t dataRva;
+        uint32_t dataSize;
+        uint32_t codePage;
+        uint32_t fileOffset;
+
+        inline bool named() const
+        {
+            return flags & NODE_NAMED;
+        }
+
+        inline bool leaf() const
+        {
+            return flags & NODE_LEAF;
+        }
+    };
+
+    ResourceTree();
+
+    /* Reads the resource directory of cofffile. Returns false if there is
+     * none. Malformed parts of the tree are skipped with a warning */
+    bool parse(CoffFile &cofffile);
+
+    void clear();
+
+    // Returns the number of nodes including the root
+    inline size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    inline bool empty() const
+    {
+        return nodes_.size() <= 1;
+    }
+
+    // Returns node 0, the root directory. Only valid when parsing
+    // succeeded
+    inline const Node &root() const
+    {
+        return nodes_[0];
+    }
+
+    inline const Node &operator[](size_t index) const
+    {
+        return nodes_[index];
+    }
+
+    inline size_t leafCount() const
+    {
+        return leafCount_;
+    }
+
+    /* Returns the name of a node, or "#id" for nodes with an integer id.
+     * Nodes directly under the root with a standard type id are named
+     * after the type */
+    QString name(const Node &node) const;
+
+    /* Returns the payload of a leaf without copying it. Pages of a mapped
+     * file are only read when the span is. Empty if the payload is not
+     * backed by file data */
+    ByteSpan data(const Node &node) const;
+
+    // Returns the name of a standard resource type, e.g. "ICON", or an
+    // empty string
+    static QString typeName(uint32_t id);
+
+private:
+    MappedFilePtr mapping_;
+
+    // Keeps the section data the directory and payloads lie in alive
+    std::vector<SectionPtr> sections_;
+    ByteSpan directory_;
+
+    std::vector<Node> nodes_;
+    size_t leafCount_;
+};
+
+typedef std::shared_ptr<ResourceTree> ResourceTreePtr;
+
+#endif // RESOURCETREE_H
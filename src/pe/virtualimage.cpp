@@ -0,0 +1,220 @@
+#include "virtualimage.h"
+#include "log.h"
+#include "pesection.h"
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+VirtualImage::VirtualImage()
+    : imageBase_(0), size_(0), data_(nullptr), mapped_(false),
+      copiedBytes_(0)
+{
+}
+
+VirtualImage::~VirtualImage()
+{
+    release();
+}
+
+bool VirtualImage::build(CoffFile &cofffile)
+{
+    release();
+
+    if (!cofffile.optionalHeaderExists_)
+    {
+        Log::error("Cannot build image: file has no optional header");
+        return false;
+    }
+
+    imageBase_ = cofffile.optionalHeader_.imageBase;
+    size_ = cofffile.optionalHeader_.sizeOfImage;
+    if (size_ == 0)
+    {
+        Log::error("Cannot build image: image size is zero");
+        return false;
+    }
+
+    if (!allocate())
+    {
+        return false;
+    }
+
+    // Without a mapping there is no file to map pages from or to read the
+    // headers from, so only the section data is copied
+    MappedFilePtr file = cofffile.mapping();
+    int fd = file ? file->handle() : -1;
+
+    if (file)
+    {
+        size_t headers = std::min<size_t>(
+            {cofffile.optionalHeader_.sizeOfHeaders, file->size(), size_});
+        place(ByteSpan(file->data(), headers), fd, 0, 0);
+    }
+
+    // Sections are created in section table order
+    std::vector<SectionPtr> &sections = cofffile.sections();
+    for (size_t i = 0;
+         i < sections.size() && i < cofffile.sectionTable_.size(); ++i)
+    {
+        const CoffFile::SectionHeader &header = cofffile.sectionTable_[i];
+        if (header.virtualAddress >= size_)
+        {
+            continue;
+        }
+
+        // data() is already limited to the virtual size, so the rest of
+        // the section stays zero
+        ByteSpan data = sections[i]->data();
+        data = data.sub(0, std::min<size_t>(data.size(),
+                                            size_ - header.virtualAddress));
+        place(data, fd, header.pointerToRawData, header.virtualAddress);
+    }
+
+    return true;
+}
+
+ByteSpan VirtualImage::bytes(uint64_t address, size_t size) const
+{
+    if (address < imageBase_)
+    {
+        return ByteSpan();
+    }
+
+    return span().sub(address - imageBase_, size);
+}
+
+bool VirtualImage::rebase(const RelocationTable &relocations, uint64_t base)
+{
+    if (data_ == nullptr)
+    {
+        Log::error("Cannot rebase: there is no image");
+        return false;
+    }
+
+    if (base == imageBase_)
+    {
+        return true;
+    }
+
+    if (relocations.empty())
+    {
+        Log::warning("Rebasing an image without relocations; absolute "
+                     "addresses in it are unchanged");
+    }
+
+    // Unsigned wrap-around gives the right result for lower bases too
+    if (!relocations.apply(data_, size_, base - imageBase_))
+    {
+        return false;
+    }
+
+    imageBase_ = base;
+    return true;
+}
+
+std::vector<SectionPtr> VirtualImage::sections(VirtualImagePtr image,
+                                               CoffFile &cofffile)
+{
+    std::vector<SectionPtr> result;
+    std::vector<SectionPtr> &sections = cofffile.sections();
+    for (size_t i = 0;
+         i < sections.size() && i < cofffile.sectionTable_.size(); ++i)
+    {
+        const CoffFile::SectionHeader &header = cofffile.sectionTable_[i];
+        PESectionPtr section = std::make_shared<PESection>(header);
+
+        // The same bytes build() placed, as they are now
+        const char *data = nullptr;
+        size_t size = 0;
+        if (header.virtualAddress < image->size_)
+        {
+            data = image->data_ + header.virtualAddress;
+            size = std::min<size_t>(sections[i]->data().size(),
+                                    image->size_ - header.virtualAddress);
+        }
+        section->setRawData(image, data, static_cast<uint32_t>(size));
+        result.push_back(std::static_pointer_cast<Section>(section));
+    }
+    return result;
+}
+
+bool VirtualImage::allocate()
+{
+    copiedBytes_ = 0;
+
+#ifdef Q_OS_UNIX
+    void *memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED)
+    {
+        data_ = static_cast<char *>(memory);
+        mapped_ = true;
+        return true;
+    }
+    Log::warning("Failed to reserve image memory, copying the image instead");
+#endif
+
+    try
+    {
+        buffer_.assign(size_, 0);
+    }
+    catch (const std::bad_alloc &)
+    {
+        Log::error("Cannot build image: out of memory");
+        size_ = 0;
+        return false;
+    }
+
+    data_ = buffer_.data();
+    mapped_ = false;
+    return true;
+}
+
+void VirtualImage::release()
+{
+#ifdef Q_OS_UNIX
+    if (mapped_ && data_ != nullptr)
+    {
+        munmap(data_, size_);
+    }
+#endif
+
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    data_ = nullptr;
+    mapped_ = false;
+}
+
+void VirtualImage::place(ByteSpan source, int fd, uint64_t fileOffset,
+                         uint32_t rva)
+{
+#ifdef Q_OS_UNIX
+    if (mapped_ && fd >= 0)
+    {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t whole = source.size() / page * page;
+        if (whole != 0 && fileOffset % page == 0 && rva % page == 0)
+        {
+            void *memory =
+                mmap(data_ + rva, whole, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(fileOffset));
+            if (memory != MAP_FAILED)
+            {
+                source = source.sub(whole);
+                rva += static_cast<uint32_t>(whole);
+            }
+        }
+    }
+#endif
+
+    if (!source.empty())
+    {
+        memcpy(data_ + rva, source.data(), source.size());
+        copiedBytes_ += source.size();
+    }
+}
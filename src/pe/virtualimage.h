@@ -0,0 +1,104 @@
+#ifndef VIRTUALIMAGE_H
+#define VIRTUALIMAGE_H
+
+#include "bytespan.h"
+#include "cofffile.h"
+#include "relocationtable.h"
+#include <memory>
+#include <vector>
+
+/* The image as the loader lays it out: one contiguous range covering
+ * [imageBase, imageBase + sizeOfImage) with the headers and each
+ * section's raw data at their RVAs and zeros everywhere else, including
+ * the BSS tails of sections whose virtual size exceeds their raw size.
+ *
+ * On POSIX systems the range is reserved as anonymous memory, so untouched
+ * pages share the kernel's zero page, and page-aligned file data is mapped
+ * over it privately, so it is neither read nor copied until a page is
+ * written. Data that is not page-aligned in the file and images parsed
+ * without a mapping are copied instead. */
+class VirtualImage
+{
+public:
+    VirtualImage();
+    ~VirtualImage();
+
+    /* Lays out the image of cofffile. Returns false if it has no optional
+     * header or the image could not be allocated */
+    bool build(CoffFile &cofffile);
+
+    inline uint64_t imageBase() const
+    {
+        return imageBase_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    inline const char *data() const
+    {
+        return data_;
+    }
+
+    // Returns the whole image, indexed by RVA
+    inline ByteSpan span() const
+    {
+        return ByteSpan(data_, size_);
+    }
+
+    /* Returns the bytes [address, address + size) or an empty span if
+     * they are outside the image */
+    ByteSpan bytes(uint64_t address, size_t size) const;
+
+    /* Returns the image for writing. Pages are copied on first write and
+     * the file is never modified */
+    inline char *writableData()
+    {
+        return data_;
+    }
+
+    /* Moves the image to base by applying relocations, which must have
+     * been read from the same file. Only pages holding fixups are copied.
+     * Returns false if there is no image or the relocations do not fit */
+    bool rebase(const RelocationTable &relocations, uint64_t base);
+
+    /* Returns sections like those of cofffile, which image was built
+     * from, whose data are views into the image. After a rebase they hold
+     * the relocated bytes. Each keeps image alive */
+    static std::vector<SectionPtr> sections(
+        std::shared_ptr<VirtualImage> image, CoffFile &cofffile);
+
+    // Returns the number of bytes that were copied rather than mapped
+    inline size_t copiedBytes() const
+    {
+        return copiedBytes_;
+    }
+
+private:
+    VirtualImage(const VirtualImage &) = delete;
+    VirtualImage &operator=(const VirtualImage &) = delete;
+
+    // Reserves size_ zeroed bytes
+    bool allocate();
+    void release();
+
+    /* Places source at rva. source starts at fileOffset in the file open
+     * as fd. Whole pages are mapped when fd is valid and both offsets are
+     * page-aligned; the rest is copied */
+    void place(ByteSpan source, int fd, uint64_t fileOffset, uint32_t rva);
+
+    uint64_t imageBase_;
+    size_t size_;
+    char *data_;
+    bool mapped_;
+    size_t copiedBytes_;
+
+    // Backing storage for the copy fallback
+    std::vector<char> buffer_;
+};
+
+typedef std::shared_ptr<VirtualImage> VirtualImagePtr;
+
+#endif // VIRTUALIMAGE_H
@@ -0,0 +1,324 @@
+#include "projectdatabase.h"
+#include "log.h"
+#include "mappedfile.h"
+#include "pe/cofffile.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+static const char MAGIC[8] = {'I', 'S', 'A', 'P', 'R', 'J', 'D', 'B'};
+
+// Written in host order; reads back differently on a host of the other
+// byte order
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Tables start at multiples of this, so mapped tables are aligned for any
+// element type
+static const size_t TABLE_ALIGNMENT = 64;
+
+namespace
+{
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t tableCount;
+    uint32_t reserved0;
+    uint64_t fileSize;
+    uint64_t binarySize;
+    uint64_t binaryHash;
+    uint64_t reserved1[2];
+};
+
+struct DirectoryEntry
+{
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t count;
+};
+
+// Returns the parts of header stored in TABLE_SECTIONS
+ProjectDatabase::SectionRecord sectionRecord(const CoffFile::SectionHeader &header)
+{
+    ProjectDatabase::SectionRecord record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.name, header.name, sizeof(record.name));
+    record.virtualAddress = header.virtualAddress;
+    record.virtualSize = header.virtualSize;
+    record.sizeOfRawData = header.sizeOfRawData;
+    record.pointerToRawData = header.pointerToRawData;
+    record.characteristics = header.characteristics;
+    return record;
+}
+
+inline uint64_t alignUp(uint64_t value)
+{
+    return (value + TABLE_ALIGNMENT - 1) & ~static_cast<uint64_t>(
+                                               TABLE_ALIGNMENT - 1);
+}
+} // namespace
+
+ProjectDatabase::ProjectDatabase()
+    : tableCount_(0), binarySize_(0), binaryHash_(0)
+{
+}
+
+bool ProjectDatabase::open(const QString &path)
+{
+    MappedFilePtr file = std::make_shared<MappedFile>();
+    if (!file->open(path))
+    {
+        return false;
+    }
+
+    Header header;
+    if (file->size() < sizeof(header))
+    {
+        Log::error("Not a project database: file is too small");
+        return false;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        Log::error("Not a project database");
+        return false;
+    }
+    if (header.byteOrder != BYTE_ORDER_MARK)
+    {
+        Log::error("Project database was saved on a host with another "
+                   "byte order");
+        return false;
+    }
+    if (header.version != VERSION)
+    {
+        Log::error(QString("Unsupported project database version %1")
+                       .arg(header.version));
+        return false;
+    }
+    if (header.fileSize != file->size())
+    {
+        Log::error("Project database is truncated");
+        return false;
+    }
+
+    ByteSpan data(file->data(), file->size());
+    ByteSpan directory = data.sub(
+        sizeof(header),
+        static_cast<size_t>(std::min<uint64_t>(
+            header.tableCount * static_cast<uint64_t>(sizeof(DirectoryEntry)),
+            data.size())));
+    if (directory.size() != header.tableCount * sizeof(DirectoryEntry))
+    {
+        Log::error("Project database directory is truncated");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.tableCount; ++i)
+    {
+        DirectoryEntry entry;
+        memcpy(&entry, directory.data() + i * sizeof(entry), sizeof(entry));
+        if (entry.elementSize == 0 || entry.offset % TABLE_ALIGNMENT != 0 ||
+            entry.count > data.size() / entry.elementSize ||
+            !data.contains(static_cast<size_t>(entry.offset),
+                           static_cast<size_t>(entry.count *
+                                               entry.elementSize)))
+        {
+            Log::error(QString("Project database table %1 lies outside "
+                               "the file")
+                           .arg(entry.id));
+            return false;
+        }
+    }
+
+    file_ = file;
+    directory_ = directory;
+    tableCount_ = header.tableCount;
+    binarySize_ = header.binarySize;
+    binaryHash_ = header.binaryHash;
+    return true;
+}
+
+bool ProjectDatabase::find(TableId id, size_t elementSize, const char *&data,
+                           size_t &count) const
+{
+    for (uint32_t i = 0; i < tableCount_; ++i)
+    {
+        DirectoryEntry entry;
+        memcpy(&entry, directory_.data() + i * sizeof(entry), sizeof(entry));
+        if (entry.id != static_cast<uint32_t>(id))
+        {
+            continue;
+        }
+        if (entry.elementSize != elementSize)
+        {
+            return false;
+        }
+
+        data = file_->data() + entry.offset;
+        count = static_cast<size_t>(entry.count);
+        return true;
+    }
+    return false;
+}
+
+QString ProjectDatabase::binaryPath() const
+{
+    Table<char> path = table<char>(TABLE_BINARY_PATH);
+    return QString::fromUtf8(path.data, static_cast<int>(path.size));
+}
+
+bool ProjectDatabase::matches(CoffFile &cofffile) const
+{
+    MappedFilePtr mapping = cofffile.mapping();
+    if (!mapping || mapping->size() != binarySize_ ||
+        hashBinary(ByteSpan(mapping->data(), mapping->size())) != binaryHash_)
+    {
+        return false;
+    }
+
+    Table<SectionRecord> sections = table<SectionRecord>(TABLE_SECTIONS);
+    if (sections.size != cofffile.sectionTable_.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < sections.size; ++i)
+    {
+        SectionRecord record = sectionRecord(cofffile.sectionTable_[i]);
+        if (memcmp(&record, &sections[i], sizeof(record)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t ProjectDatabase::hashBinary(ByteSpan data)
+{
+    // FNV-1a over 64-bit words, then the bytes left over. Multiplying by the
+    // odd prime is invertible, so changing any one word changes the hash
+    static const uint64_t PRIME = 0x100000001B3ull;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    size_t words = data.size() / sizeof(uint64_t);
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t word;
+        memcpy(&word, data.data() + i * sizeof(word), sizeof(word));
+        hash = (hash ^ word) * PRIME;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < data.size(); ++i)
+    {
+        hash = (hash ^ data.u8(i)) * PRIME;
+    }
+    return (hash ^ data.size()) * PRIME;
+}
+
+ProjectDatabaseWriter::ProjectDatabaseWriter()
+    : binarySize_(0), binaryHash_(0)
+{
+}
+
+bool ProjectDatabaseWriter::setBinary(const QString &path, CoffFile &cofffile)
+{
+    MappedFilePtr mapping = cofffile.mapping();
+    if (!mapping)
+    {
+        return false;
+    }
+
+    QByteArray utf8 = path.toUtf8();
+    addCopy(ProjectDatabase::TABLE_BINARY_PATH,
+            std::vector<char>(utf8.constData(),
+                              utf8.constData() + utf8.size()));
+    binarySize_ = mapping->size();
+    binaryHash_ = ProjectDatabase::hashBinary(
+        ByteSpan(mapping->data(), mapping->size()));
+
+    std::vector<ProjectDatabase::SectionRecord> sections;
+    for (const CoffFile::SectionHeader &header : cofffile.sectionTable_)
+    {
+        sections.push_back(sectionRecord(header));
+    }
+    addCopy(ProjectDatabase::TABLE_SECTIONS, sections);
+    return true;
+}
+
+void ProjectDatabaseWriter::add(ProjectDatabase::TableId id,
+                                size_t elementSize, const void *data,
+                                size_t count)
+{
+    Pending table;
+    table.id = static_cast<uint32_t>(id);
+    table.elementSize = static_cast<uint32_t>(elementSize);
+    table.data = data;
+    table.count = count;
+    tables_.push_back(table);
+}
+
+bool ProjectDatabaseWriter::save(const QString &path) const
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = ProjectDatabase::VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.tableCount = static_cast<uint32_t>(tables_.size());
+    header.binarySize = binarySize_;
+    header.binaryHash = binaryHash_;
+
+    // Lay the tables out after the directory
+    std::vector<DirectoryEntry> directory;
+    uint64_t offset =
+        alignUp(sizeof(header) + tables_.size() * sizeof(DirectoryEntry));
+    for (const Pending &table : tables_)
+    {
+        DirectoryEntry entry;
+        entry.id = table.id;
+        entry.elementSize = table.elementSize;
+        entry.offset = offset;
+        entry.count = table.count;
+        directory.push_back(entry);
+        offset = alignUp(offset + table.count * table.elementSize);
+    }
+    header.fileSize = offset;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        Log::error(QString("Failed to save project: ") + file.errorString());
+        return false;
+    }
+
+    static const char padding[TABLE_ALIGNMENT] = {};
+    uint64_t written = 0;
+    auto write = [&](const void *data, uint64_t size) {
+        if (size != 0 &&
+            file.write(static_cast<const char *>(data),
+                       static_cast<qint64>(size)) != static_cast<qint64>(size))
+        {
+            return false;
+        }
+        written += size;
+        return true;
+    };
+    auto pad = [&]() { return write(padding, alignUp(written) - written); };
+
+    bool ok = write(&header, sizeof(header)) &&
+              write(directory.data(),
+                    directory.size() * sizeof(DirectoryEntry)) &&
+              pad();
+    for (size_t i = 0; ok && i < tables_.size(); ++i)
+    {
+        ok = write(tables_[i].data, tables_[i].count * tables_[i].elementSize) &&
+             pad();
+    }
+
+    if (!ok || !file.commit())
+    {
+        Log::error(QString("Failed to save project: ") + file.errorString());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,229 @@
+#ifndef PROJECTDATABASE_H
+#define PROJECTDATABASE_H
+
+#include "bytespan.h"
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Kept out of this header, which the analysis tables include: they pull in
+// QObject and its keywords
+class CoffFile;
+class MappedFile;
+
+/* A saved project: the analysis results for one binary, stored as flat
+ * arrays in a single file. Each array starts at a 64-byte aligned offset
+ * and has the same layout as in memory. Opening a database maps the file
+ * and reads the tables in place. Restoring the analysis copies whole
+ * arrays instead of decoding records.
+ *
+ *   Header     magic, version, byte order mark, table count, and the size
+ *              and hash of the binary
+ *   Directory  one entry per table: id, element size, offset and count
+ *   Tables     the arrays
+ *
+ * The binary is not stored in the database. It is mapped again from its
+ * path and checked against the saved size, hash and section table. */
+class ProjectDatabase
+{
+public:
+    // Bump when the layout of any table or the binary hash changes
+    static const uint32_t VERSION = 2;
+
+    enum TableId
+    {
+        TABLE_BINARY_PATH = 1, // char, UTF-8
+        TABLE_SECTIONS, // SectionRecord
+        TABLE_IMAGE_BASE, // uint64_t, one value
+
+        TABLE_INSTRUCTION_OFFSETS,
+        TABLE_INSTRUCTION_LENGTHS,
+        TABLE_INSTRUCTION_BRANCH_TYPES,
+        TABLE_INSTRUCTION_TARGET_INDICES,
+        TABLE_INSTRUCTION_TARGETS,
+        TABLE_INSTRUCTION_DATA_INDICES,
+        TABLE_INSTRUCTION_DATA_REFERENCES,
+
+        TABLE_FUNCTION_STARTS,
+        TABLE_FUNCTION_ENDS,
+        TABLE_FUNCTION_SOURCES,
+
+        TABLE_XREFS_FROM_KEYS,
+        TABLE_XREFS_FROM_VALUES,
+        TABLE_XREFS_FROM_TYPES,
+        TABLE_XREFS_TO_KEYS,
+        TABLE_XREFS_TO_VALUES,
+        TABLE_XREFS_TO_TYPES,
+
+        TABLE_BLOCK_STARTS,
+        TABLE_SUCCESSOR_OFFSETS,
+        TABLE_SUCCESSORS,
+        TABLE_PREDECESSOR_OFFSETS,
+        TABLE_PREDECESSORS,
+
+        TABLE_STRINGS, // StringScanner::String
+
+        TABLE_ANNOTATION_ADDRESSES,
+        // Offsets of each annotation in the text, plus the text size
+        TABLE_ANNOTATION_TEXT_OFFSETS,
+        TABLE_ANNOTATION_TEXT, // char, UTF-8
+    };
+
+    // The parts of a section header that must match when reopening
+    struct SectionRecord
+    {
+        char name[8];
+        uint32_t virtualAddress;
+        uint32_t virtualSize;
+        uint32_t sizeOfRawData;
+        uint32_t pointerToRawData;
+        uint32_t characteristics;
+        uint32_t reserved;
+    };
+
+    // A view of a table in the mapping
+    template <typename T> struct Table
+    {
+        const T *data;
+        size_t size;
+
+        inline const T *begin() const
+        {
+            return data;
+        }
+
+        inline const T *end() const
+        {
+            return data + size;
+        }
+
+        inline const T &operator[](size_t index) const
+        {
+            return data[index];
+        }
+    };
+
+    ProjectDatabase();
+
+    /* Maps the database at path and checks its header and directory.
+     * Returns false with an error logged if it cannot be used */
+    bool open(const QString &path);
+
+    /* Returns a table in place. Empty if it is missing or its elements
+     * are not of type T */
+    template <typename T> Table<T> table(TableId id) const
+    {
+        Table<T> result = {nullptr, 0};
+        const char *data;
+        size_t count;
+        if (find(id, sizeof(T), data, count))
+        {
+            result.data = reinterpret_cast<const T *>(data);
+            result.size = count;
+        }
+        return result;
+    }
+
+    /* Copies a table into values. Returns false if it is missing or its
+     * elements are not of type T */
+    template <typename T> bool read(TableId id, std::vector<T> &values) const
+    {
+        const char *data;
+        size_t count;
+        if (!find(id, sizeof(T), data, count))
+        {
+            return false;
+        }
+        const T *begin = reinterpret_cast<const T *>(data);
+        values.assign(begin, begin + count);
+        return true;
+    }
+
+    // Returns the path the binary had when the database was saved
+    QString binaryPath() const;
+
+    inline uint64_t binarySize() const
+    {
+        return binarySize_;
+    }
+
+    inline uint64_t binaryHash() const
+    {
+        return binaryHash_;
+    }
+
+    /* Returns true if cofffile, which must be mapped, has the size, hash
+     * and sections of the binary the database was saved for */
+    bool matches(CoffFile &cofffile) const;
+
+    /* Hashes the whole binary and its size, so an edit anywhere in it is
+     * noticed. Reads about as fast as memory for large files */
+    static uint64_t hashBinary(ByteSpan data);
+
+private:
+    // Gets a table's data if it exists with the given element size
+    bool find(TableId id, size_t elementSize, const char *&data,
+              size_t &count) const;
+
+    std::shared_ptr<MappedFile> file_;
+    ByteSpan directory_;
+    uint32_t tableCount_;
+    uint64_t binarySize_;
+    uint64_t binaryHash_;
+};
+
+typedef std::shared_ptr<ProjectDatabase> ProjectDatabasePtr;
+
+/* Collects tables and writes them as a ProjectDatabase file */
+class ProjectDatabaseWriter
+{
+public:
+    ProjectDatabaseWriter();
+
+    /* Records the binary the results belong to: its path, size, hash and
+     * section table. Returns false if cofffile is not mapped */
+    bool setBinary(const QString &path, CoffFile &cofffile);
+
+    /* Adds a table without copying it. values must not change or be
+     * destroyed before save() */
+    template <typename T>
+    void add(ProjectDatabase::TableId id, const std::vector<T> &values)
+    {
+        add(id, sizeof(T), values.data(), values.size());
+    }
+
+    // Adds a copy of a table
+    template <typename T>
+    void addCopy(ProjectDatabase::TableId id, const std::vector<T> &values)
+    {
+        const char *begin = reinterpret_cast<const char *>(values.data());
+        buffers_.push_back(std::make_shared<std::vector<char>>(
+            begin, begin + values.size() * sizeof(T)));
+        add(id, sizeof(T), buffers_.back()->data(), values.size());
+    }
+
+    /* Writes the database to path, replacing it only once the whole file
+     * is written. Returns false with an error logged on failure */
+    bool save(const QString &path) const;
+
+private:
+    struct Pending
+    {
+        uint32_t id;
+        uint32_t elementSize;
+        const void *data;
+        uint64_t count;
+    };
+
+    void add(ProjectDatabase::TableId id, size_t elementSize, const void *data,
+             size_t count);
+
+    std::vector<Pending> tables_;
+    std::vector<std::shared_ptr<std::vector<char>>> buffers_;
+    uint64_t binarySize_;
+    uint64_t binaryHash_;
+};
+
+#endif // PROJECTDATABASE_H
@@ -1,21 +1,170 @@
 #include "projecthandler.h"
 #include "isa.h"
+#include "log.h"
+#include "projectdatabase.h"
+#include <QFileInfo>
 
 ProjectHandler::ProjectHandler()
 {
+    // The loader lives on the GUI thread, so these run there
+    QObject::connect(&loader_, &ProjectLoader::stageStarted, &loader_,
+                     [this](ProjectLoader::ProjectPtr project, int stage) {
+                         stageStarted(project, stage);
+                     });
+    QObject::connect(&loader_, &ProjectLoader::stageFinished, &loader_,
+                     [this](ProjectLoader::ProjectPtr project, int stage) {
+                         stageFinished(project, stage);
+                     });
+    QObject::connect(&loader_, &ProjectLoader::finished, &loader_,
+                     [this](ProjectLoader::ProjectPtr project, bool completed) {
+                         finished(project, completed);
+                     });
+}
+
+void ProjectHandler::open(const QString &path)
+{
+    close();
+    loading_ = loader_.start(path);
+}
+
+void ProjectHandler::openDatabase(const QString &path)
+{
+    close();
+    loading_ = loader_.startDatabase(path);
+}
+
+bool ProjectHandler::rebase(uint64_t base)
+{
+    if (path_.isEmpty())
+    {
+        Log::error("Nothing to rebase: no binary is open");
+        return false;
+    }
+    
+    QString path = path_;
+    close();
+    loading_ = loader_.start(path, base);
+    return true;
+}
 
+bool ProjectHandler::save(const QString &path)
+{
+    if (loading_ || !pefile_ || !strings_ || !annotations_)
+    {
+        Log::error("Nothing to save until a project has finished loading");
+        return false;
+    }
+    
+    // The tables are added without copies, so nothing may change them
+    // until the file is written; this all runs on the GUI thread
+    ProjectDatabaseWriter writer;
+    if (!writer.setBinary(QFileInfo(path_).absoluteFilePath(), *pefile_))
+    {
+        Log::error("The binary of the project is no longer mapped");
+        return false;
+    }
+    ISA::get()->disassembler()->save(writer);
+    strings_->save(writer);
+    annotations_->save(writer);
+    
+    if (!writer.save(path))
+    {
+        return false;
+    }
+    Log::normal(QString("Saved project to %1").arg(path));
+    return true;
 }
 
-void ProjectHandler::open(CoffFilePtr pefile)
+void ProjectHandler::close()
 {
+    loader_.cancel();
+    
     MainWindow *window = ISA::get()->mainWindow();
     window->reset();
-    window->updatePEInfo(pefile);
+    ISA::get()->sectionHandler()->clear();
+    ISA::get()->disassembler()->setArchitecture(nullptr, 0);
+    
+    pefile_ = nullptr;
+    image_ = nullptr;
+    relocations_ = nullptr;
+    imports_ = nullptr;
+    exports_ = nullptr;
+    resources_ = nullptr;
+    strings_ = nullptr;
+    annotations_ = nullptr;
+    path_ = QString();
+    loading_ = nullptr;
+}
+
+void ProjectHandler::cancel()
+{
+    loader_.cancel();
+}
+
+void ProjectHandler::stageStarted(ProjectLoader::ProjectPtr project, int stage)
+{
+    if (project != loading_)
+    {
+        return;
+    }
+    
+    ISA::get()->mainWindow()->showProgress(
+        stage, ProjectLoader::STAGE_COUNT,
+        ProjectLoader::stageName(static_cast<ProjectLoader::Stage>(stage)));
+}
+
+void ProjectHandler::stageFinished(ProjectLoader::ProjectPtr project, int stage)
+{
+    if (project != loading_)
+    {
+        return;
+    }
     
-    std::vector<SectionPtr> &sections = pefile->sections();
+    MainWindow *window = ISA::get()->mainWindow();
+    switch (stage)
+    {
+    case ProjectLoader::STAGE_PARSE:
+        path_ = project->path;
+        pefile_ = project->pefile;
+        window->updatePEInfo(pefile_);
+        window->updateHex(pefile_);
+        break;
+    case ProjectLoader::STAGE_SECTIONS:
+        // A copy, since the disassembly stage still reads the loader's
+        *ISA::get()->sectionHandler() = project->sections;
+        break;
+    case ProjectLoader::STAGE_TABLES:
+        relocations_ = project->relocations;
+        image_ = project->image;
+        imports_ = project->imports;
+        exports_ = project->exports;
+        resources_ = project->resources;
+        strings_ = project->strings;
+        annotations_ = project->annotations;
+        break;
+    case ProjectLoader::STAGE_DISASSEMBLY:
+    {
+        Disassembler *disassembler = ISA::get()->disassembler();
+        disassembler->swap(project->disassembler);
+        window->updateDisassembly(disassembler, annotations_);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ProjectHandler::finished(ProjectLoader::ProjectPtr project, bool completed)
+{
+    if (project != loading_)
+    {
+        return;
+    }
     
-    for (SectionPtr &section : sections)
+    loading_ = nullptr;
+    ISA::get()->mainWindow()->hideProgress();
+    if (completed)
     {
-        ISA::get()->sectionHandler()->addSection(section);
+        Log::normal(QString("Loaded %1").arg(project->path));
     }
 }
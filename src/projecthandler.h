@@ -1,15 +1,123 @@
 #ifndef PROJECTHANDLER_H
 #define PROJECTHANDLER_H
 
+#include "annotationtable.h"
 #include "pe/cofffile.h"
+#include "pe/exporttable.h"
+#include "pe/importtable.h"
+#include "pe/relocationtable.h"
+#include "pe/resourcetree.h"
+#include "pe/virtualimage.h"
+#include "projectloader.h"
+#include "stringscanner.h"
 
 class ProjectHandler
 {
 public:
     ProjectHandler();
     
-    /* Open a new project using a CoffFile */
-    void open(CoffFilePtr pefile);
+    /* Closes the current project and starts loading the PE file at path
+     * in the background. The parts of the new project are shown as the
+     * stages producing them finish */
+    void open(const QString &path);
+    
+    /* Like open(), but reopens a project saved with save(). The saved
+     * analysis is shown instead of being computed again */
+    void openDatabase(const QString &path);
+    
+    /* Loads the open binary again with its image at base, e.g. the
+     * address a crash dump shows it at, and analyses it there. Zero
+     * returns to the preferred base. Returns false with an error logged if
+     * no binary is open */
+    bool rebase(uint64_t base);
+    
+    /* Saves the open project as a database at path. Returns false with an
+     * error logged if there is no complete project or writing fails */
+    bool save(const QString &path);
+    
+    /* Stops loading without waiting for the loader's worker. Parts that
+     * were already shown are kept */
+    void cancel();
+    
+    // Returns true while a project is being loaded
+    inline bool loading() const
+    {
+        return loading_ != nullptr;
+    }
+    
+    /* Returns the rebased image of the open project. Null if there is no
+     * project or it is loaded at its preferred base */
+    inline VirtualImagePtr image() const
+    {
+        return image_;
+    }
+
+    /* Returns the imports of the open project. Null if there is no
+     * project */
+    inline ImportTablePtr imports() const
+    {
+        return imports_;
+    }
+
+    /* Returns the exports of the open project. Null if there is no
+     * project */
+    inline ExportTablePtr exports() const
+    {
+        return exports_;
+    }
+
+    /* Returns the base relocations the open project was rebased with.
+     * Null if there is no project or it is loaded at its preferred base */
+    inline RelocationTablePtr relocations() const
+    {
+        return relocations_;
+    }
+
+    /* Returns the resources of the open project. Null if there is no
+     * project */
+    inline ResourceTreePtr resources() const
+    {
+        return resources_;
+    }
+
+    /* Returns the strings found in the sections of the open project. Null
+     * if there is no project */
+    inline StringScannerPtr strings() const
+    {
+        return strings_;
+    }
+
+    /* Returns the user's comments on the open project. Null if there is
+     * no project */
+    inline AnnotationTablePtr annotations() const
+    {
+        return annotations_;
+    }
+
+private:
+    // Slots for the loader's signals, run on the GUI thread
+    void stageStarted(ProjectLoader::ProjectPtr project, int stage);
+    void stageFinished(ProjectLoader::ProjectPtr project, int stage);
+    void finished(ProjectLoader::ProjectPtr project, bool completed);
+
+    // Closes the current project before another is loaded
+    void close();
+
+    ProjectLoader loader_;
+
+    // The project being loaded. Signals about any other are stale
+    ProjectLoader::ProjectPtr loading_;
+
+    // The binary of the open project
+    QString path_;
+    CoffFilePtr pefile_;
+    VirtualImagePtr image_;
+    RelocationTablePtr relocations_;
+    ImportTablePtr imports_;
+    ExportTablePtr exports_;
+    ResourceTreePtr resources_;
+    StringScannerPtr strings_;
+    AnnotationTablePtr annotations_;
 };
 
 #endif // PROJECTHANDLER_H
@@ -0,0 +1,370 @@
+#include "projectloader.h"
+#include "log.h"
+#include "mappedfile.h"
+#include <QFileInfo>
+
+ProjectLoader::Project::Project()
+    : base(0), disassembler(&sections), cancelled(false)
+{
+}
+
+ProjectLoader::ProjectLoader(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<ProjectLoader::ProjectPtr>("ProjectLoader::ProjectPtr");
+
+    // Emitted from the worker, so this is queued to the GUI thread
+    connect(this, &ProjectLoader::finished, this, &ProjectLoader::reap);
+}
+
+ProjectLoader::~ProjectLoader()
+{
+    for (Worker &worker : workers_)
+    {
+        worker.project->cancelled = true;
+    }
+    for (Worker &worker : workers_)
+    {
+        worker.thread.join();
+    }
+}
+
+ProjectLoader::ProjectPtr ProjectLoader::start(const QString &path,
+                                               uint64_t base)
+{
+    ProjectPtr project = std::make_shared<Project>();
+    project->path = path;
+    project->base = base;
+    start(project);
+    return project;
+}
+
+ProjectLoader::ProjectPtr ProjectLoader::startDatabase(const QString &path)
+{
+    ProjectPtr project = std::make_shared<Project>();
+    project->databasePath = path;
+    start(project);
+    return project;
+}
+
+void ProjectLoader::start(ProjectPtr project)
+{
+    cancel();
+
+    project->disassembler.setCancelFlag(&project->cancelled);
+
+    Worker worker;
+    worker.project = project;
+    worker.thread = std::thread(&ProjectLoader::run, this, project);
+    workers_.push_back(std::move(worker));
+    current_ = project;
+}
+
+void ProjectLoader::cancel()
+{
+    if (current_)
+    {
+        current_->cancelled = true;
+        current_ = nullptr;
+    }
+}
+
+void ProjectLoader::reap(ProjectPtr project)
+{
+    for (auto worker = workers_.begin(); worker != workers_.end(); ++worker)
+    {
+        if (worker->project == project)
+        {
+            // The worker returns right after emitting finished()
+            worker->thread.join();
+            workers_.erase(worker);
+            break;
+        }
+    }
+    if (current_ == project)
+    {
+        current_ = nullptr;
+    }
+}
+
+QString ProjectLoader::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_PARSE:
+        return tr("Parsing headers");
+    case STAGE_SECTIONS:
+        return tr("Loading sections");
+    case STAGE_TABLES:
+        return tr("Reading imports, exports and resources");
+    case STAGE_DISASSEMBLY:
+        return tr("Disassembling");
+    default:
+        return QString();
+    }
+}
+
+void ProjectLoader::run(ProjectPtr project)
+{
+    typedef bool (ProjectLoader::*StageFunction)(Project &);
+    static const StageFunction stages[STAGE_COUNT] = {
+        &ProjectLoader::parse, &ProjectLoader::loadSections,
+        &ProjectLoader::loadTables, &ProjectLoader::disassemble};
+
+    // The binary's path is not known yet when reopening a database
+    QString name =
+        project->databasePath.isEmpty() ? project->path : project->databasePath;
+
+    for (int stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        emit stageStarted(project, stage);
+        bool succeeded = (this->*stages[stage])(*project);
+
+        // A cancelled pass leaves partial results; do not publish them
+        if (project->cancelled)
+        {
+            Log::warning(QString("Cancelled loading %1").arg(name));
+            emit finished(project, false);
+            return;
+        }
+        if (!succeeded)
+        {
+            Log::error(QString("Failed to load %1").arg(name));
+            emit finished(project, false);
+            return;
+        }
+        emit stageFinished(project, stage);
+    }
+
+    emit finished(project, true);
+}
+
+bool ProjectLoader::parse(Project &project)
+{
+    if (!project.databasePath.isEmpty())
+    {
+        return openDatabase(project);
+    }
+
+    MappedFilePtr file = std::make_shared<MappedFile>();
+    if (!file->open(project.path))
+    {
+        return false;
+    }
+
+    PEFilePtr pefile = std::make_shared<PEFile>();
+    if (!pefile->parse(file))
+    {
+        return false;
+    }
+
+    if (project.base == 0)
+    {
+        project.base = pefile->optionalHeader_.imageBase;
+    }
+    project.pefile = pefile;
+    return true;
+}
+
+bool ProjectLoader::openDatabase(Project &project)
+{
+    ProjectDatabasePtr database = std::make_shared<ProjectDatabase>();
+    if (!database->open(project.databasePath))
+    {
+        return false;
+    }
+
+    // A project moved together with its binary still finds it next to the
+    // database
+    QString path = database->binaryPath();
+    if (!QFileInfo(path).exists())
+    {
+        QString moved = QFileInfo(project.databasePath).absolutePath() + "/" +
+                        QFileInfo(path).fileName();
+        if (QFileInfo(moved).exists())
+        {
+            path = moved;
+        }
+    }
+
+    MappedFilePtr file = std::make_shared<MappedFile>();
+    if (!file->open(path))
+    {
+        return false;
+    }
+
+    PEFilePtr pefile = std::make_shared<PEFile>();
+    if (!pefile->parse(file))
+    {
+        return false;
+    }
+
+    if (!database->matches(*pefile))
+    {
+        Log::error(QString("%1 has changed since the project was saved")
+                       .arg(path));
+        return false;
+    }
+
+    // The analysis was saved at the base the image was loaded at
+    ProjectDatabase::Table<uint64_t> base =
+        database->table<uint64_t>(ProjectDatabase::TABLE_IMAGE_BASE);
+    project.base =
+        base.size == 1 ? base[0] : pefile->optionalHeader_.imageBase;
+
+    project.path = path;
+    project.pefile = pefile;
+    project.database = database;
+    return true;
+}
+
+void ProjectLoader::buildImage(Project &project)
+{
+    project.relocations = std::make_shared<RelocationTable>();
+    project.relocations->parse(*project.pefile);
+
+    project.image = std::make_shared<VirtualImage>();
+    if (!project.image->build(*project.pefile))
+    {
+        project.image = nullptr;
+    }
+}
+
+bool ProjectLoader::loadSections(Project &project)
+{
+    PEFile &pefile = *project.pefile;
+    std::vector<SectionPtr> sections = pefile.sections();
+
+    // Anywhere else than the preferred base the code and data are read
+    // from the relocated image, so the disassembly shows the addresses the
+    // module had there
+    if (project.base != pefile.optionalHeader_.imageBase)
+    {
+        buildImage(project);
+        if (!project.image ||
+            !project.image->rebase(*project.relocations, project.base))
+        {
+            return false;
+        }
+        sections = VirtualImage::sections(project.image, pefile);
+        Log::normal(
+            QString("Loading the image at 0x%1").arg(project.base, 0, 16));
+    }
+
+    for (SectionPtr &section : sections)
+    {
+        project.sections.addSection(section);
+    }
+    project.sections.buildIndex();
+    return true;
+}
+
+bool ProjectLoader::loadTables(Project &project)
+{
+    PEFile &pefile = *project.pefile;
+
+    project.imports = std::make_shared<ImportTable>();
+    project.imports->parse(pefile, project.base);
+
+    project.exports = std::make_shared<ExportTable>();
+    project.exports->parse(pefile);
+
+    project.resources = std::make_shared<ResourceTree>();
+    project.resources->parse(pefile);
+
+    project.strings = std::make_shared<StringScanner>();
+    project.annotations = std::make_shared<AnnotationTable>();
+    if (project.database)
+    {
+        return project.strings->load(*project.database) &&
+               project.annotations->load(*project.database);
+    }
+
+    // The scanner is published and outlives the project, so it only sees
+    // the flag while scanning
+    project.strings->setCancelFlag(&project.cancelled);
+    bool scanned = project.strings->scan(pefile.sections());
+    project.strings->setCancelFlag(nullptr);
+    return scanned;
+}
+
+bool ProjectLoader::disassemble(Project &project)
+{
+    PEFile &pefile = *project.pefile;
+    Disassembler &disassembler = project.disassembler;
+
+    ArchitecturePtr arch = pefile.createArchitecture();
+    if (arch)
+    {
+        // Calls through the IAT are shown as module!name
+        arch->setSymbolResolver(project.imports);
+    }
+    disassembler.setArchitecture(arch, project.base);
+    if (!arch)
+    {
+        return true;
+    }
+
+    // The functions and everything found from them were saved
+    if (project.database)
+    {
+        return disassembler.load(*project.database);
+    }
+
+    uint64_t imageBase = project.base;
+
+    // The exception directory lists every x64 function with exact bounds;
+    // they also seed recursive descent
+    std::vector<CoffFile::RuntimeFunction> runtimeFunctions;
+    pefile.runtimeFunctions(runtimeFunctions);
+    for (const CoffFile::RuntimeFunction &function : runtimeFunctions)
+    {
+        disassembler.addFunction(imageBase + function.beginAddress,
+                                 imageBase + function.endAddress,
+                                 FunctionTable::SOURCE_EXCEPTION);
+        disassembler.addSeed(imageBase + function.beginAddress);
+    }
+
+    // Exports in executable sections are functions; the others are data
+    // and forwarded exports have no code here
+    bool exportedCode = false;
+    for (size_t i = 0; i < project.exports->size(); ++i)
+    {
+        const ExportTable::Export &entry = (*project.exports)[i];
+        SectionPtr section = project.sections.find(entry.rva);
+        if (!entry.forwarded() && section && section->executable())
+        {
+            disassembler.addFunction(imageBase + entry.rva, 0,
+                                     FunctionTable::SOURCE_EXPORT);
+            disassembler.addSeed(imageBase + entry.rva);
+            exportedCode = true;
+        }
+    }
+
+    uint32_t entryPoint = pefile.optionalHeader_.addressOfEntryPoint;
+    if (pefile.optionalHeaderExists_ && entryPoint != 0)
+    {
+        disassembler.addFunction(imageBase + entryPoint, 0,
+                                 FunctionTable::SOURCE_ENTRY);
+        disassembler.addSeed(imageBase + entryPoint);
+    }
+
+    // Follow the code from the seeds when there are any. Images with none
+    // (e.g. resource-only DLLs) fall back to a linear sweep
+    bool decoded;
+    if (pefile.optionalHeaderExists_ &&
+        (entryPoint != 0 || exportedCode || !runtimeFunctions.empty()))
+    {
+        decoded = disassembler.recursiveDescent();
+    }
+    else
+    {
+        decoded = disassembler.parallelSweep();
+    }
+    if (!decoded)
+    {
+        return false;
+    }
+
+    return disassembler.buildGraph() &&
+           disassembler.discoverFunctions(runtimeFunctions.empty());
+}
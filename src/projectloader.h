@@ -0,0 +1,160 @@
+#ifndef PROJECTLOADER_H
+#define PROJECTLOADER_H
+
+#include "annotationtable.h"
+#include "disassembler.h"
+#include "pe/exporttable.h"
+#include "pe/importtable.h"
+#include "pe/pefile.h"
+#include "pe/relocationtable.h"
+#include "pe/resourcetree.h"
+#include "pe/virtualimage.h"
+#include "projectdatabase.h"
+#include "sectionhandler.h"
+#include "stringscanner.h"
+#include <QObject>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Maps a PE file and runs the analysis passes on a worker thread, so large
+ * files do not freeze the window. The work is split into stages that each
+ * fill in part of a Project and then signal; the receiver publishes that
+ * part on the GUI thread while the later stages go on.
+ *
+ * Cancelling never waits for the worker. Each project has its own flag,
+ * which the long passes poll; a cancelled worker may still be finishing
+ * while the next load runs, and is joined when its finished() signal
+ * arrives. */
+class ProjectLoader : public QObject
+{
+    Q_OBJECT
+public:
+    enum Stage
+    {
+        STAGE_PARSE,       // map the file and parse the headers
+        STAGE_SECTIONS,    // index the sections
+        STAGE_TABLES,      // imports, exports, relocations, resources...
+        STAGE_DISASSEMBLY, // decode, build the graph and find functions
+        STAGE_COUNT,
+    };
+
+    /* The results of one load. A stage only writes its own members and
+     * never touches them again after signalling, so the receiver may read
+     * them while later stages run */
+    struct Project
+    {
+        Project();
+
+        // The binary. When reopening a saved project it is only known
+        // after STAGE_PARSE
+        QString path;
+        QString databasePath;
+
+        // The address the image is loaded at. Zero for the preferred base,
+        // which STAGE_PARSE fills in. Elsewhere the sections are read from
+        // the relocated image
+        uint64_t base;
+
+        // STAGE_PARSE. The database is null unless a saved project is
+        // being reopened
+        PEFilePtr pefile;
+        ProjectDatabasePtr database;
+
+        // STAGE_SECTIONS
+        SectionHandler sections;
+
+        // STAGE_SECTIONS, and only when the image is not loaded at its
+        // preferred base
+        RelocationTablePtr relocations;
+        VirtualImagePtr image;
+
+        // STAGE_TABLES
+        ImportTablePtr imports;
+        ExportTablePtr exports;
+        ResourceTreePtr resources;
+        StringScannerPtr strings;
+        AnnotationTablePtr annotations;
+
+        // STAGE_DISASSEMBLY. Works on sections
+        Disassembler disassembler;
+
+        // Set to stop the worker
+        std::atomic<bool> cancelled;
+    };
+
+    typedef std::shared_ptr<Project> ProjectPtr;
+
+    ProjectLoader(QObject *parent = 0);
+
+    // Cancels the running loads and waits for them
+    ~ProjectLoader();
+
+    /* Starts loading path, cancelling the previous load if it is still
+     * running. A nonzero base loads the image there instead of at its
+     * preferred base. Returns the project the stages will fill in */
+    ProjectPtr start(const QString &path, uint64_t base = 0);
+
+    /* Like start(), but reopens a project saved as a ProjectDatabase at
+     * path. The saved results are read instead of running the analysis,
+     * and the image is loaded at the base it was saved at */
+    ProjectPtr startDatabase(const QString &path);
+
+    /* Asks the running load to stop and returns at once. Its worker stops
+     * at the next check and emits finished() with completed false. Stages
+     * that have finished keep their results. Does nothing if no load is
+     * running */
+    void cancel();
+
+    // Returns a description of a stage for progress displays
+    static QString stageName(Stage stage);
+
+signals:
+    /* Emitted from the worker when a stage begins */
+    void stageStarted(ProjectLoader::ProjectPtr project, int stage);
+
+    /* Emitted from the worker when the results of a stage are complete */
+    void stageFinished(ProjectLoader::ProjectPtr project, int stage);
+
+    /* Emitted from the worker when the load ends. completed is false if it
+     * failed or was cancelled */
+    void finished(ProjectLoader::ProjectPtr project, bool completed);
+
+private:
+    struct Worker
+    {
+        ProjectPtr project;
+        std::thread thread;
+    };
+
+    // Starts the worker for a new project
+    void start(ProjectPtr project);
+
+    // Joins the worker of a project that has finished, on the GUI thread
+    void reap(ProjectPtr project);
+
+    // Runs the stages on the worker thread
+    void run(ProjectPtr project);
+
+    // Opens project.databasePath and the binary it was saved for
+    bool openDatabase(Project &project);
+
+    // Reads the relocations and lays out the image
+    void buildImage(Project &project);
+
+    // Each returns false if the load cannot go on
+    bool parse(Project &project);
+    bool loadSections(Project &project);
+    bool loadTables(Project &project);
+    bool disassemble(Project &project);
+
+    // Workers that have not been joined yet; the last one is current
+    // unless it was cancelled
+    std::vector<Worker> workers_;
+    ProjectPtr current_;
+};
+
+Q_DECLARE_METATYPE(ProjectLoader::ProjectPtr)
+
+#endif // PROJECTLOADER_H
@@ -1,5 +1,6 @@
 #ifndef SECTION_H
 #define SECTION_H
+#include "bytespan.h"
 #include <memory>
 
 class Section
@@ -17,6 +18,13 @@ public:
     // Returns the size of the section in bytes
     virtual uint32_t size() = 0;
 
+    // Returns the position in the file of the first byte of data()
+    virtual uint32_t fileOffset() = 0;
+
+    // Returns the bytes backing the section starting at offset(). This may
+    // be shorter than size() when the tail of the section is zero-filled
+    virtual ByteSpan data() = 0;
+
 private:
 };
 
@@ -1,5 +1,7 @@
 #include "sectionhandler.h"
 #include "section.h"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 SectionHandler::SectionHandler()
@@ -9,4 +11,143 @@ SectionHandler::SectionHandler()
 void SectionHandler::addSection(SectionPtr section)
 {
     sections_.push_back(section);
+    index_.clear();
+}
+
+void SectionHandler::clear()
+{
+    sections_.clear();
+    index_.clear();
+}
+
+void SectionHandler::buildIndex()
+{
+    index_.clear();
+
+    std::vector<Interval> sections;
+    sections.reserve(sections_.size());
+    for (const SectionPtr &section : sections_)
+    {
+        ByteSpan data = section->data();
+
+        Interval interval;
+        interval.sectionBegin = section->offset();
+        interval.dataEnd = interval.sectionBegin + static_cast<uint32_t>(data.size());
+        interval.begin = interval.sectionBegin;
+        interval.end = std::max(interval.begin + section->size(), interval.dataEnd);
+        interval.fileOffset = section->fileOffset();
+        interval.data = data.data();
+        interval.section = section;
+
+        // Skip empty sections and ones that wrap the address space
+        if (interval.end <= interval.begin || interval.dataEnd < interval.begin)
+        {
+            continue;
+        }
+        sections.push_back(interval);
+    }
+
+    std::stable_sort(sections.begin(), sections.end(), [](const Interval &a, const Interval &b) {
+        return a.begin < b.begin;
+    });
+
+    // Cut the sections into disjoint intervals. open holds the sections
+    // reaching past position, the one owning it on top; a section resumes
+    // where the ones starting after it end
+    std::vector<const Interval *> open;
+    uint32_t position = 0;
+    auto flush = [&](uint64_t limit) {
+        while (!open.empty())
+        {
+            const Interval *top = open.back();
+            if (top->end <= position)
+            {
+                open.pop_back();
+                continue;
+            }
+            if (position >= limit)
+            {
+                break;
+            }
+
+            Interval interval = *top;
+            interval.begin = position;
+            interval.end = static_cast<uint32_t>(std::min<uint64_t>(top->end, limit));
+            index_.push_back(interval);
+            position = interval.end;
+        }
+    };
+
+    index_.reserve(sections.size());
+    for (const Interval &section : sections)
+    {
+        flush(section.begin);
+        position = section.begin;
+        open.push_back(&section);
+    }
+    flush(UINT64_MAX);
+}
+
+const SectionHandler::Interval *SectionHandler::lookup(uint32_t rva) const
+{
+    // Find the interval starting at or before rva
+    auto it = std::upper_bound(index_.begin(), index_.end(), rva, [](uint32_t rva, const Interval &interval) {
+        return rva < interval.begin;
+    });
+    if (it == index_.begin())
+    {
+        return nullptr;
+    }
+    --it;
+
+    if (rva >= it->end)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+
+SectionPtr SectionHandler::find(uint32_t rva) const
+{
+    const Interval *interval = lookup(rva);
+    return interval ? interval->section : nullptr;
+}
+
+bool SectionHandler::fileOffset(uint32_t rva, uint32_t &offset) const
+{
+    const Interval *interval = lookup(rva);
+    if (!interval || rva >= interval->dataEnd)
+    {
+        return false;
+    }
+
+    offset = interval->fileOffset + (rva - interval->sectionBegin);
+    return true;
+}
+
+const char *SectionHandler::pointer(uint32_t rva) const
+{
+    const Interval *interval = lookup(rva);
+    if (!interval || rva >= interval->dataEnd)
+    {
+        return nullptr;
+    }
+
+    return interval->data + (rva - interval->sectionBegin);
+}
+
+ByteSpan SectionHandler::bytes(uint32_t rva) const
+{
+    const Interval *interval = lookup(rva);
+    if (!interval || rva >= interval->dataEnd)
+    {
+        return ByteSpan();
+    }
+
+    return ByteSpan(interval->data + (rva - interval->sectionBegin), interval->dataEnd - rva);
+}
+
+ByteSpan SectionHandler::bytes(uint32_t rva, size_t size) const
+{
+    return bytes(rva).sub(0, size);
 }
@@ -10,8 +10,60 @@ public:
 
     void addSection(SectionPtr section);
 
+    // Removes all sections
+    void clear();
+
+    inline const std::vector<SectionPtr> &sections() const
+    {
+        return sections_;
+    }
+
+    /* Builds the address index used by the lookups below. Call once after
+     * the last addSection; adding or clearing sections drops the index */
+    void buildIndex();
+
+    /* Returns the section containing rva, or null. When sections overlap
+     * the one starting last wins */
+    SectionPtr find(uint32_t rva) const;
+
+    /* Converts an RVA to a file offset. Returns false if the RVA is not
+     * backed by file data, e.g. in the zero-filled tail of a section */
+    bool fileOffset(uint32_t rva, uint32_t &offset) const;
+
+    /* Returns a pointer to the byte at rva or null if it is not backed
+     * by file data */
+    const char *pointer(uint32_t rva) const;
+
+    /* Returns the bytes from rva to the end of the section data, or an
+     * empty span */
+    ByteSpan bytes(uint32_t rva) const;
+
+    /* Returns the bytes [rva, rva + size), or an empty span unless all of
+     * them lie in the data of one section */
+    ByteSpan bytes(uint32_t rva, size_t size) const;
+
 private:
+    /* The part [begin, end) of a section not covered by a section
+     * starting after it. The other members describe the whole section */
+    struct Interval
+    {
+        uint32_t begin;
+        uint32_t end;
+        // Start of the section and end of the part backed by data
+        uint32_t sectionBegin;
+        uint32_t dataEnd;
+        uint32_t fileOffset;
+        const char *data;
+        SectionPtr section;
+    };
+
+    // Returns the interval containing rva, or null
+    const Interval *lookup(uint32_t rva) const;
+
     std::vector<SectionPtr> sections_;
+
+    // Disjoint and sorted by begin
+    std::vector<Interval> index_;
 };
 
 #endif // SECTIONHANDLER_H
@@ -0,0 +1,478 @@
+#include "stringscanner.h"
+#include "projectdatabase.h"
+#include "workstealingscheduler.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRINGSCANNER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRINGSCANNER_SSE2
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Sections are split into chunks of this size for the workers. It is a
+// multiple of the block size
+static const size_t CHUNK_SIZE = 1 << 20;
+
+// Bytes classified at once
+static const size_t BLOCK_SIZE = 64;
+
+// Bytes holding 64 characters of UTF-16LE
+static const unsigned SUPERBLOCK_SIZE = 128;
+
+namespace
+{
+inline unsigned countTrailingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+inline bool printable(uint8_t byte)
+{
+    return (byte >= 0x20 && byte <= 0x7E) || byte == '\t';
+}
+
+// Sets bit i of printableMask if data[i] is printable and of zeroMask if
+// it is zero, for a block of BLOCK_SIZE bytes.
+//
+// Printable bytes are found with one signed comparison: adding 0x60 moves
+// 0x20-0x7E to -128..-34, and every other byte above -34
+inline void classifyBlock(const char *data, uint64_t &printableMask,
+                          uint64_t &zeroMask)
+{
+#if defined(STRINGSCANNER_AVX2)
+    const __m256i bias = _mm256_set1_epi8(0x60);
+    const __m256i limit = _mm256_set1_epi8(-33);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i zero = _mm256_setzero_si256();
+
+    printableMask = 0;
+    zeroMask = 0;
+    for (unsigned i = 0; i < BLOCK_SIZE; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i));
+        __m256i text = _mm256_or_si256(
+            _mm256_cmpgt_epi8(limit, _mm256_add_epi8(bytes, bias)),
+            _mm256_cmpeq_epi8(bytes, tab));
+        printableMask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                             _mm256_movemask_epi8(text)))
+                         << i;
+        zeroMask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero))))
+                    << i;
+    }
+#elif defined(STRINGSCANNER_SSE2)
+    const __m128i bias = _mm_set1_epi8(0x60);
+    const __m128i limit = _mm_set1_epi8(-33);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i zero = _mm_setzero_si128();
+
+    printableMask = 0;
+    zeroMask = 0;
+    for (unsigned i = 0; i < BLOCK_SIZE; i += 16)
+    {
+        __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i text =
+            _mm_or_si128(_mm_cmplt_epi8(_mm_add_epi8(bytes, bias), limit),
+                         _mm_cmpeq_epi8(bytes, tab));
+        printableMask |= static_cast<uint64_t>(_mm_movemask_epi8(text)) << i;
+        zeroMask |= static_cast<uint64_t>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)))
+                    << i;
+    }
+#else
+    printableMask = 0;
+    zeroMask = 0;
+    for (unsigned i = 0; i < BLOCK_SIZE; ++i)
+    {
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        printableMask |= static_cast<uint64_t>(printable(byte)) << i;
+        zeroMask |= static_cast<uint64_t>(byte == 0) << i;
+    }
+#endif
+}
+
+// Packs the even bits of value into the low 32 bits
+inline uint64_t compressEvenBits(uint64_t value)
+{
+#if defined(__BMI2__)
+    return _pext_u64(value, 0x5555555555555555ull);
+#else
+    value &= 0x5555555555555555ull;
+    value = (value | (value >> 1)) & 0x3333333333333333ull;
+    value = (value | (value >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    value = (value | (value >> 4)) & 0x00FF00FF00FF00FFull;
+    value = (value | (value >> 8)) & 0x0000FFFF0000FFFFull;
+    value = (value | (value >> 16)) & 0x00000000FFFFFFFFull;
+    return value;
+#endif
+}
+
+// The character masks of a superblock of 128 bytes
+struct SuperBlock
+{
+    // Bytes [0, 64) and [64, 128)
+    uint64_t ascii[2];
+
+    // UTF-16LE characters starting at bytes shift + 2j
+    uint64_t wide[2];
+};
+
+/* Classifies the bytes [position, position + SUPERBLOCK_SIZE) of data.
+ * Bytes outside the data, including those before it for a negative
+ * position, count as neither printable nor zero */
+void classifySuperBlock(const char *data, size_t size, int64_t position,
+                        SuperBlock &block)
+{
+    uint64_t text[2];
+    uint64_t zero[2];
+    if (position >= 0 && static_cast<uint64_t>(position) <= size &&
+        size - position >= SUPERBLOCK_SIZE)
+    {
+        classifyBlock(data + position, text[0], zero[0]);
+        classifyBlock(data + position + BLOCK_SIZE, text[1], zero[1]);
+    }
+    else
+    {
+        text[0] = text[1] = zero[0] = zero[1] = 0;
+        for (unsigned i = 0; i < SUPERBLOCK_SIZE; ++i)
+        {
+            int64_t index = position + i;
+            if (index >= 0 && static_cast<uint64_t>(index) < size)
+            {
+                uint8_t byte = static_cast<uint8_t>(data[index]);
+                text[i / 64] |= static_cast<uint64_t>(printable(byte)) << (i % 64);
+                zero[i / 64] |= static_cast<uint64_t>(byte == 0) << (i % 64);
+            }
+        }
+    }
+
+    int64_t next = position + SUPERBLOCK_SIZE;
+    uint64_t nextZero = next >= 0 && static_cast<uint64_t>(next) < size &&
+                        data[next] == 0;
+
+    block.ascii[0] = text[0];
+    block.ascii[1] = text[1];
+    if ((text[0] | text[1]) == 0)
+    {
+        block.wide[0] = block.wide[1] = 0;
+        return;
+    }
+
+    // A character is a printable byte followed by a zero byte
+    uint64_t characters[2] = {
+        text[0] & ((zero[0] >> 1) | (zero[1] << 63)),
+        text[1] & ((zero[1] >> 1) | (nextZero << 63))};
+    for (unsigned shift = 0; shift < 2; ++shift)
+    {
+        block.wide[shift] = compressEvenBits(characters[0] >> shift) |
+                            (compressEvenBits(characters[1] >> shift) << 32);
+    }
+}
+
+/* Returns the bits i of mask for which bits [i - window + 1, i] are all
+ * set, taking the bits before mask from previous. window is at most 64.
+ * Each step doubles the length checked */
+inline uint64_t erode(uint64_t mask, uint64_t previous, unsigned window)
+{
+    unsigned length = 1;
+    while (length * 2 <= window)
+    {
+        mask &= (mask << length) | (previous >> (64 - length));
+        previous &= previous << length;
+        length *= 2;
+    }
+    if (length < window)
+    {
+        unsigned rest = window - length;
+        mask &= (mask << rest) | (previous >> (64 - rest));
+    }
+    return mask;
+}
+
+/* Follows the runs of one encoding and alignment through blocks of 64
+ * characters.
+ *
+ * Only runs of at least window characters are tracked: eroding the mask
+ * leaves the characters at which a run has reached that length, so a run
+ * starts window - 1 characters before the first of them and ends at the
+ * first character after the last. Short runs, the common case in code
+ * and compressed data, never leave the bit operations. */
+struct RunStream
+{
+    // The masks of the previous block
+    uint64_t previous;
+    uint64_t previousLong;
+
+    int64_t start;
+    bool open;
+
+    // Runs starting in [first, end) are reported
+    int64_t first;
+    int64_t end;
+};
+
+template <typename Report>
+inline void feed(RunStream &stream, uint64_t mask, int64_t base,
+                 unsigned window, Report report)
+{
+    uint64_t longRun = erode(mask, stream.previous, window);
+    uint64_t after = (longRun << 1) | (stream.previousLong >> 63);
+
+    // Characters where a long run begins to qualify, and where one ends
+    uint64_t events = (longRun & ~after) | (~mask & after);
+    while (events != 0)
+    {
+        unsigned bit = countTrailingZeros(events);
+        events &= events - 1;
+
+        if ((mask >> bit) & 1)
+        {
+            stream.start = base + bit - (window - 1);
+            stream.open = true;
+        }
+        else
+        {
+            if (stream.open && stream.start >= stream.first &&
+                stream.start < stream.end)
+            {
+                report(stream.start, base + bit);
+            }
+            stream.open = false;
+        }
+    }
+
+    stream.previous = mask;
+    stream.previousLong = longRun;
+}
+}
+
+StringScanner::StringScanner() : minimumLength_(4), cancel_(nullptr)
+{
+}
+
+void StringScanner::clear()
+{
+    strings_.clear();
+    strings_.shrink_to_fit();
+}
+
+void StringScanner::save(ProjectDatabaseWriter &writer) const
+{
+    writer.add(ProjectDatabase::TABLE_STRINGS, strings_);
+}
+
+bool StringScanner::load(const ProjectDatabase &database)
+{
+    if (!database.read(ProjectDatabase::TABLE_STRINGS, strings_))
+    {
+        clear();
+        return false;
+    }
+
+    for (const String &string : strings_)
+    {
+        if (string.encoding != ENCODING_ASCII &&
+            string.encoding != ENCODING_UTF16LE)
+        {
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void StringScanner::scanRange(ByteSpan data, size_t begin, size_t end,
+                              uint32_t rva,
+                              std::vector<String> &strings) const
+{
+    const char *bytes = data.data();
+    int64_t size = static_cast<int64_t>(data.size());
+    if (static_cast<int64_t>(end) > size)
+    {
+        end = static_cast<size_t>(size);
+    }
+    if (begin >= end)
+    {
+        return;
+    }
+
+    uint32_t minimumLength = minimumLength_;
+    unsigned window = std::min(minimumLength, 64u);
+
+    // ASCII in bytes, and UTF-16LE at even and odd byte offsets in
+    // characters. Character k of alignment a starts at byte a + 2k
+    RunStream ascii = RunStream();
+    ascii.first = begin;
+    ascii.end = end;
+
+    RunStream wide[2];
+    for (unsigned alignment = 0; alignment < 2; ++alignment)
+    {
+        wide[alignment] = RunStream();
+        wide[alignment].first = (static_cast<int64_t>(begin) - alignment + 1) / 2;
+        wide[alignment].end = (static_cast<int64_t>(end) - alignment + 1) / 2;
+    }
+
+    auto emitAscii = [&](int64_t start, int64_t stop) {
+        if (stop - start >= minimumLength)
+        {
+            String string;
+            string.rva = rva + static_cast<uint32_t>(start);
+            string.length = static_cast<uint32_t>(stop - start);
+            string.encoding = ENCODING_ASCII;
+            strings.push_back(string);
+        }
+    };
+    auto emitWide = [&](unsigned alignment, int64_t start, int64_t stop) {
+        if (stop - start >= minimumLength)
+        {
+            String string;
+            string.rva = rva + static_cast<uint32_t>(alignment + start * 2);
+            string.length = static_cast<uint32_t>(stop - start);
+            string.encoding = ENCODING_UTF16LE;
+            strings.push_back(string);
+        }
+    };
+
+    // Two superblocks before begin bring the streams into the state they
+    // would have if the scan had started earlier. Runs found there started
+    // before begin and are not reported. The scan goes on past end until
+    // the runs that started before it are over
+    int64_t position = static_cast<int64_t>(begin) - 2 * SUPERBLOCK_SIZE;
+    int64_t stop = static_cast<int64_t>(end) + 2 * SUPERBLOCK_SIZE;
+    SuperBlock block;
+    while (position < size &&
+           (position < stop || ascii.open || wide[0].open || wide[1].open))
+    {
+        classifySuperBlock(bytes, data.size(), position, block);
+
+        // Nothing changes while there is no text, e.g. in padding
+        if ((block.ascii[0] | block.ascii[1]) == 0 && ascii.previous == 0 &&
+            wide[0].previous == 0 && wide[1].previous == 0 && !ascii.open &&
+            !wide[0].open && !wide[1].open)
+        {
+            position += SUPERBLOCK_SIZE;
+            continue;
+        }
+
+        feed(ascii, block.ascii[0], position, window, emitAscii);
+        feed(ascii, block.ascii[1], position + BLOCK_SIZE, window, emitAscii);
+
+        for (unsigned shift = 0; shift < 2; ++shift)
+        {
+            unsigned alignment = (position + shift) & 1;
+            feed(wide[alignment], block.wide[shift],
+                 (position + shift - alignment) / 2, window,
+                 [&](int64_t start, int64_t stop) {
+                     emitWide(alignment, start, stop);
+                 });
+        }
+
+        position += SUPERBLOCK_SIZE;
+    }
+
+    // Runs that reach the end of the data
+    if (ascii.open && ascii.start >= ascii.first && ascii.start < ascii.end)
+    {
+        emitAscii(ascii.start, size);
+    }
+    for (unsigned alignment = 0; alignment < 2; ++alignment)
+    {
+        RunStream &stream = wide[alignment];
+        if (stream.open && stream.start >= stream.first &&
+            stream.start < stream.end)
+        {
+            emitWide(alignment, stream.start, (size - alignment) / 2);
+        }
+    }
+}
+
+bool StringScanner::scan(const std::vector<SectionPtr> &sections,
+                         unsigned threadCount)
+{
+    strings_.clear();
+
+    struct Chunk
+    {
+        SectionPtr section;
+        size_t begin;
+        size_t end;
+        std::vector<String> strings;
+    };
+
+    std::vector<SectionPtr> sorted = sections;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const SectionPtr &a, const SectionPtr &b) {
+                  return a->offset() < b->offset();
+              });
+
+    std::vector<Chunk> chunks;
+    for (const SectionPtr &section : sorted)
+    {
+        size_t size = section->data().size();
+        for (size_t begin = 0; begin < size; begin += CHUNK_SIZE)
+        {
+            Chunk chunk;
+            chunk.section = section;
+            chunk.begin = begin;
+            chunk.end = std::min(size, begin + CHUNK_SIZE);
+            chunks.push_back(std::move(chunk));
+        }
+    }
+
+    WorkStealingScheduler scheduler(threadCount);
+    scheduler.run(chunks.size(), [&](unsigned worker, size_t index) {
+        // The remaining chunks are drained without being scanned
+        if (cancelled())
+        {
+            return;
+        }
+
+        Chunk &chunk = chunks[index];
+        scanRange(chunk.section->data(), chunk.begin, chunk.end,
+                  chunk.section->offset(), chunk.strings);
+
+        // The encodings are found in separate passes over the block
+        std::sort(chunk.strings.begin(), chunk.strings.end(),
+                  [](const String &a, const String &b) {
+                      return a.rva < b.rva;
+                  });
+    });
+
+    if (cancelled())
+    {
+        return false;
+    }
+
+    size_t total = 0;
+    for (const Chunk &chunk : chunks)
+    {
+        total += chunk.strings.size();
+    }
+    strings_.reserve(total);
+    for (const Chunk &chunk : chunks)
+    {
+        strings_.insert(strings_.end(), chunk.strings.begin(),
+                        chunk.strings.end());
+    }
+    return true;
+}
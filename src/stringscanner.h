@@ -0,0 +1,107 @@
+#ifndef STRINGSCANNER_H
+#define STRINGSCANNER_H
+#include "bytespan.h"
+#include "section.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ProjectDatabase;
+class ProjectDatabaseWriter;
+
+/* Finds runs of printable ASCII and UTF-16LE text in section data, like
+ * strings(1). Printable means 0x20-0x7E and tab; UTF-16LE characters are
+ * those with a zero high byte, at either byte alignment.
+ *
+ * Bytes are classified 64 at a time into bit masks with SSE2 or AVX2
+ * when the compiler targets them, and runs are found by counting zero
+ * bits in the masks, so long stretches of text or binary data cost a few
+ * instructions per 64 bytes. Sections are split into chunks that are
+ * scanned in parallel. Results are plain records in one array. */
+class StringScanner
+{
+public:
+    enum Encoding
+    {
+        ENCODING_ASCII,
+        ENCODING_UTF16LE,
+    };
+
+    struct String
+    {
+        uint32_t rva;
+
+        // Length in characters, without a terminator
+        uint32_t length;
+        Encoding encoding;
+
+        // Returns the length in bytes
+        inline uint32_t size() const
+        {
+            return encoding == ENCODING_UTF16LE ? length * 2 : length;
+        }
+    };
+
+    StringScanner();
+
+    /* Sets the number of characters a run needs to be reported. The
+     * default is 4 */
+    inline void setMinimumLength(uint32_t length)
+    {
+        minimumLength_ = length > 0 ? length : 1;
+    }
+
+    /* scan() stops between chunks and returns false once flag is set.
+     * Null disables cancellation */
+    inline void setCancelFlag(const std::atomic<bool> *flag)
+    {
+        cancel_ = flag;
+    }
+
+    inline bool cancelled() const
+    {
+        return cancel_ && cancel_->load(std::memory_order_relaxed);
+    }
+
+    inline uint32_t minimumLength() const
+    {
+        return minimumLength_;
+    }
+
+    /* Scans the data of every section. The results replace the previous
+     * ones and are sorted by RVA. A thread count of zero uses one thread
+     * per core. Returns false with no results if cancelled */
+    bool scan(const std::vector<SectionPtr> &sections,
+              unsigned threadCount = 0);
+
+    /* Appends the runs in data that start in [begin, end) to strings.
+     * Runs may extend past end; a run that is already under way at begin
+     * belongs to the previous range. rva is the RVA of data */
+    void scanRange(ByteSpan data, size_t begin, size_t end, uint32_t rva,
+                   std::vector<String> &strings) const;
+
+    inline const std::vector<String> &strings() const
+    {
+        return strings_;
+    }
+
+    void clear();
+
+    /* Adds the strings to a database. They are referenced, not copied, so
+     * the scanner must not change before the database is saved */
+    void save(ProjectDatabaseWriter &writer) const;
+
+    /* Replaces the strings with the ones in database instead of
+     * scanning. Returns false and leaves none if they are missing */
+    bool load(const ProjectDatabase &database);
+
+private:
+    uint32_t minimumLength_;
+    const std::atomic<bool> *cancel_;
+    std::vector<String> strings_;
+};
+
+typedef std::shared_ptr<StringScanner> StringScannerPtr;
+
+#endif // STRINGSCANNER_H
@@ -4,6 +4,10 @@
 #include "pe/pefile.h"
 #include "ui_mainwindow.h"
 
+#include <QInputDialog>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QStatusBar>
 #include <QStringListModel>
 #include <isa.h>
 
@@ -15,6 +19,15 @@ MainWindow::MainWindow(QWidget *parent)
     setCorner(Qt::BottomLeftCorner, Qt::LeftDockWidgetArea);
 
     ui_->textConsole->setModel(LogModel::get());
+
+    progress_ = new QProgressBar(this);
+    progress_->setMaximumWidth(200);
+    cancelButton_ = new QPushButton(tr("Cancel"), this);
+    connect(cancelButton_, &QPushButton::clicked, this,
+            &MainWindow::cancelLoading);
+    statusBar()->addPermanentWidget(progress_);
+    statusBar()->addPermanentWidget(cancelButton_);
+    hideProgress();
 }
 
 MainWindow::~MainWindow()
@@ -32,25 +45,67 @@ void MainWindow::on_actionNew_triggered()
 
     if (!path.isEmpty())
     {
-        QFile file(path);
-        if (!file.open(QFile::ReadOnly))
-        {
-            Log::error(QString("Failed to open file: ") + file.errorString());
-        }
+        ISA::get()->projectHandler()->open(path);
+    }
+}
+
+void MainWindow::on_actionOpen_triggered()
+{
+    QString path = QFileDialog::getOpenFileName(
+        this, tr("Open Database"), QString(),
+        tr("Project Databases (*.isadb);;All Files (*)"));
 
-        PEFilePtr pefile = std::make_shared<PEFile>();
+    if (!path.isEmpty())
+    {
+        Log::normal(QString("Opening project %1").arg(path));
+        ISA::get()->projectHandler()->openDatabase(path);
+    }
+}
+
+void MainWindow::on_actionSave_triggered()
+{
+    QString path = QFileDialog::getSaveFileName(
+        this, tr("Save Database"), QString(),
+        tr("Project Databases (*.isadb);;All Files (*)"));
+
+    if (!path.isEmpty())
+    {
+        ISA::get()->projectHandler()->save(path);
+    }
+}
+
+void MainWindow::on_actionRebase_triggered()
+{
+    bool ok;
+    QString text = QInputDialog::getText(
+        this, tr("Rebase"),
+        tr("Address to load the image at (hex), empty for its own base:"),
+        QLineEdit::Normal, QString(), &ok);
+    if (!ok)
+    {
+        return;
+    }
 
-        if (pefile->parse(&file))
+    uint64_t base = 0;
+    text = text.trimmed();
+    if (!text.isEmpty())
+    {
+        base = text.toULongLong(&ok, 16);
+        if (!ok || base == 0)
         {
-            ISA::get()->projectHandler()->open(pefile);
+            Log::error(QString("Not an address: %1").arg(text));
+            return;
         }
     }
+    ISA::get()->projectHandler()->rebase(base);
 }
 
-
 void MainWindow::reset()
 {
     ui_->peInfo->updateFile(nullptr);
+    ui_->disassembly->setDisassembler(nullptr);
+    ui_->disassembly->setAnnotations(nullptr);
+    ui_->hex->setFile(nullptr);
 }
 
 
@@ -58,3 +113,44 @@ void MainWindow::updatePEInfo(CoffFilePtr cofffile)
 {
     ui_->peInfo->updateFile(cofffile);
 }
+
+
+void MainWindow::updateHex(CoffFilePtr cofffile)
+{
+    ui_->hex->setFile(cofffile);
+}
+
+
+void MainWindow::updateDisassembly(Disassembler *disassembler,
+                                   AnnotationTablePtr annotations)
+{
+    ui_->disassembly->setAnnotations(annotations);
+    ui_->disassembly->setDisassembler(disassembler);
+}
+
+
+void MainWindow::showProgress(int stage, int stageCount,
+                              const QString &description)
+{
+    progress_->setRange(0, stageCount);
+    progress_->setValue(stage);
+    progress_->show();
+    cancelButton_->show();
+    statusBar()->showMessage(description);
+}
+
+
+void MainWindow::hideProgress()
+{
+    progress_->hide();
+    cancelButton_->hide();
+    statusBar()->clearMessage();
+}
+
+
+void MainWindow::cancelLoading()
+{
+    // The load stops at its next check; the progress is hidden once it has
+    statusBar()->showMessage(tr("Cancelling..."));
+    ISA::get()->projectHandler()->cancel();
+}
@@ -3,8 +3,13 @@
 
 #include <QFileDialog>
 #include <QMainWindow>
+#include "annotationtable.h"
 #include "pe/cofffile.h"
 
+class Disassembler;
+class QProgressBar;
+class QPushButton;
+
 namespace Ui
 {
 class MainWindow;
@@ -24,12 +29,33 @@ public:
     
     /* Updates the PE Info tab */
     void updatePEInfo(CoffFilePtr cofffile);
+    
+    /* Shows the bytes of the file behind cofffile in the Hex tab */
+    void updateHex(CoffFilePtr cofffile);
+    
+    /* Shows the instructions of disassembler in the Disassembly tab, with
+     * the comments in annotations */
+    void updateDisassembly(Disassembler *disassembler,
+                           AnnotationTablePtr annotations);
+    
+    /* Shows the progress of loading a project in the status bar, with a
+     * button that cancels it */
+    void showProgress(int stage, int stageCount, const QString &description);
+    
+    /* Hides the progress shown by showProgress */
+    void hideProgress();
 
 private:
     Ui::MainWindow *ui_;
+    QProgressBar *progress_;
+    QPushButton *cancelButton_;
 
 private slots:
     void on_actionNew_triggered();
+    void on_actionOpen_triggered();
+    void on_actionSave_triggered();
+    void on_actionRebase_triggered();
+    void cancelLoading();
 };
 
 #endif // MAINWINDOW_H
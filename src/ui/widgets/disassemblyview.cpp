@@ -0,0 +1,401 @@
+#include "disassemblyview.h"
+#include "disassembler.h"
+
+#include <QApplication>
+#include <QContextMenuEvent>
+#include <QFontDatabase>
+#include <QInputDialog>
+#include <QMenu>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <algorithm>
+#include <climits>
+
+// Characters reserved for the instruction text when sizing the
+// horizontal scroll bar
+static const int TEXT_COLUMNS = 64;
+
+DisassemblyView::DisassemblyView(QWidget *parent)
+    : QAbstractScrollArea(parent), disassembler_(nullptr), cacheFirst_(0),
+      cacheCount_(0), lineHeight_(1), ascent_(0), charWidth_(1),
+      addressDigits_(8), addressColor_(128, 128, 128),
+      bytesColor_(128, 128, 128), mnemonicColor_(0, 102, 204),
+      registerColor_(0, 153, 76), constantColor_(204, 102, 0),
+      targetColor_(153, 51, 204)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    updateMetrics();
+}
+
+void DisassemblyView::setDisassembler(Disassembler *disassembler)
+{
+    disassembler_ = disassembler;
+    refresh();
+}
+
+void DisassemblyView::setAnnotations(AnnotationTablePtr annotations)
+{
+    annotations_ = annotations;
+    cacheCount_ = 0;
+    viewport()->update();
+}
+
+void DisassemblyView::refresh()
+{
+    arch_ = disassembler_ ? disassembler_->architecture() : nullptr;
+    cacheCount_ = 0;
+
+    addressDigits_ = 8;
+    if (disassembler_)
+    {
+        const InstructionStore &instructions = disassembler_->instructions();
+        if (instructions.size() != 0 &&
+            instructions.address(instructions.size() - 1) > 0xFFFFFFFFull)
+        {
+            addressDigits_ = 16;
+        }
+    }
+
+    updateScrollBars();
+    verticalScrollBar()->setValue(0);
+    viewport()->update();
+}
+
+void DisassemblyView::goToAddress(uint64_t address)
+{
+    if (!disassembler_)
+    {
+        return;
+    }
+
+    const InstructionStore &instructions = disassembler_->instructions();
+    size_t index = instructions.find(address);
+    if (index == InstructionStore::npos)
+    {
+        index = instructions.lowerBound(address);
+    }
+
+    verticalScrollBar()->setValue(static_cast<int>(
+        std::min<size_t>(index, verticalScrollBar()->maximum())));
+}
+
+void DisassemblyView::contextMenuEvent(QContextMenuEvent *event)
+{
+    if (!disassembler_ || !arch_)
+    {
+        return;
+    }
+
+    // The instruction under the cursor, if there is one
+    const InstructionStore &instructions = disassembler_->instructions();
+    size_t index = static_cast<size_t>(verticalScrollBar()->value()) +
+                   static_cast<size_t>(std::max(event->pos().y(), 0) / lineHeight_);
+    bool onRow = index < instructions.size();
+    uint64_t address = onRow ? instructions.address(index) : 0;
+    uint64_t next = onRow ? address + instructions.length(index) : 0;
+
+    const FunctionTable &functions = disassembler_->functions();
+    size_t function = onRow ? functions.find(address) : FunctionTable::npos;
+    bool startsFunction = function != FunctionTable::npos && functions.start(function) == address;
+
+    QMenu menu(this);
+    QAction *undefine = menu.addAction(tr("Undefine"));
+    QAction *defineFunction = menu.addAction(tr("Define Function"));
+    QAction *undefineFunction = menu.addAction(tr("Undefine Function"));
+    menu.addSeparator();
+    QAction *defineCode = menu.addAction(tr("Define Code At..."));
+    menu.addSeparator();
+    QAction *comment = menu.addAction(tr("Comment..."));
+    undefine->setEnabled(onRow);
+    defineFunction->setEnabled(onRow && !startsFunction);
+    undefineFunction->setEnabled(startsFunction);
+    comment->setEnabled(onRow && annotations_);
+
+    QAction *chosen = menu.exec(event->globalPos());
+    if (chosen == nullptr)
+    {
+        return;
+    }
+
+    if (chosen == comment)
+    {
+        // Comments do not move rows, so only the cached text is stale
+        size_t note = annotations_->find(address);
+        bool ok;
+        QString text = QInputDialog::getText(
+            this, tr("Comment"), tr("Comment at %1:").arg(address, 0, 16), QLineEdit::Normal,
+            note != AnnotationTable::npos ? annotations_->text(note) : QString(), &ok);
+        if (ok)
+        {
+            annotations_->set(address, text.trimmed());
+            cacheCount_ = 0;
+            viewport()->update();
+        }
+        return;
+    }
+
+    uint64_t target = 0;
+    if (chosen == undefine)
+    {
+        disassembler_->undefine(address, next);
+    }
+    else if (chosen == defineFunction)
+    {
+        disassembler_->defineFunction(address, 0);
+    }
+    else if (chosen == undefineFunction)
+    {
+        disassembler_->undefineFunction(address);
+    }
+    else if (chosen == defineCode)
+    {
+        // Offer the bytes after the row, where undefined code usually is
+        bool ok;
+        QString text = QInputDialog::getText(this, tr("Define Code"), tr("Address (hex):"), QLineEdit::Normal,
+                                             onRow ? QString::number(next, 16) : QString(), &ok);
+        if (!ok)
+        {
+            return;
+        }
+        target = text.trimmed().toULongLong(&ok, 16);
+        if (!ok || !disassembler_->defineCode(target))
+        {
+            return;
+        }
+    }
+
+    // The edit moved rows, so the cache and the row count are stale
+    int position = verticalScrollBar()->value();
+    refresh();
+    if (target != 0)
+    {
+        goToAddress(target);
+    }
+    else
+    {
+        verticalScrollBar()->setValue(std::min(position, verticalScrollBar()->maximum()));
+    }
+}
+
+void DisassemblyView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+
+    if (!disassembler_ || !arch_)
+    {
+        return;
+    }
+
+    const InstructionStore &instructions = disassembler_->instructions();
+    size_t first = static_cast<size_t>(verticalScrollBar()->value());
+    if (first >= instructions.size())
+    {
+        return;
+    }
+
+    // One extra row for the partially visible one at the bottom
+    size_t count = std::min<size_t>(visibleRows() + 1,
+                                    instructions.size() - first);
+    fillCache(first, count);
+
+    painter.setFont(font());
+
+    int addressX = charWidth_ - horizontalScrollBar()->value();
+    int bytesX = addressX + (addressDigits_ + 2) * charWidth_;
+    int textX = bytesX + (BYTE_COLUMNS * 3 + 1) * charWidth_;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Row &row = rows_[first + i - cacheFirst_];
+        int y = static_cast<int>(i) * lineHeight_ + ascent_;
+
+        painter.setPen(addressColor_);
+        painter.drawText(addressX, y, row.address);
+
+        painter.setPen(bytesColor_);
+        painter.drawText(bytesX, y, row.bytes);
+
+        // The font is fixed width, so runs are placed by character count
+        // instead of being measured
+        for (const Run &run : row.runs)
+        {
+            painter.setPen(tokenColor(run.type));
+            painter.drawText(textX + run.column * charWidth_, y, run.text);
+        }
+
+        if (!row.note.isEmpty())
+        {
+            painter.setPen(addressColor_);
+            painter.drawText(textX + (row.textLength + 2) * charWidth_, y,
+                             row.note);
+        }
+    }
+}
+
+void DisassemblyView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void DisassemblyView::scrollContentsBy(int dx, int dy)
+{
+    viewport()->update();
+}
+
+void DisassemblyView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange ||
+        event->type() == QEvent::PaletteChange)
+    {
+        updateMetrics();
+        updateScrollBars();
+        viewport()->update();
+    }
+}
+
+void DisassemblyView::updateMetrics()
+{
+    QFontMetrics metrics(font());
+    lineHeight_ = std::max(metrics.height(), 1);
+    ascent_ = metrics.ascent();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    charWidth_ = std::max(metrics.horizontalAdvance(QLatin1Char('0')), 1);
+#else
+    charWidth_ = std::max(metrics.width(QLatin1Char('0')), 1);
+#endif
+    textColor_ = palette().text().color();
+}
+
+void DisassemblyView::updateScrollBars()
+{
+    size_t total = disassembler_ ? disassembler_->instructions().size() : 0;
+    int rows = visibleRows();
+
+    size_t maximum = total > static_cast<size_t>(rows) ? total - rows : 0;
+    verticalScrollBar()->setRange(
+        0, static_cast<int>(std::min<size_t>(maximum, INT_MAX)));
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setSingleStep(1);
+
+    int width = (addressDigits_ + 2 + BYTE_COLUMNS * 3 + 1 + TEXT_COLUMNS) *
+                charWidth_;
+    horizontalScrollBar()->setRange(
+        0, std::max(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(charWidth_);
+}
+
+int DisassemblyView::visibleRows() const
+{
+    return std::max(viewport()->height() / lineHeight_, 1);
+}
+
+void DisassemblyView::fillCache(size_t first, size_t count)
+{
+    if (cacheCount_ != 0 && first >= cacheFirst_ &&
+        first + count <= cacheFirst_ + cacheCount_)
+    {
+        return;
+    }
+
+    size_t total = disassembler_->instructions().size();
+    size_t begin = first > PREFETCH_ROWS ? first - PREFETCH_ROWS : 0;
+    size_t end = std::min(total, first + count + PREFETCH_ROWS);
+
+    // The cache only grows with the viewport, never with scrolling
+    if (rows_.size() < end - begin)
+    {
+        rows_.resize(end - begin);
+    }
+
+    for (size_t index = begin; index < end; ++index)
+    {
+        decodeRow(index, rows_[index - begin]);
+    }
+
+    cacheFirst_ = begin;
+    cacheCount_ = end - begin;
+}
+
+void DisassemblyView::decodeRow(size_t index, Row &row)
+{
+    const InstructionStore &instructions = disassembler_->instructions();
+    uint64_t address = instructions.address(index);
+    uint8_t length = instructions.length(index);
+
+    row.address = QString::number(address, 16).rightJustified(
+        addressDigits_, QLatin1Char('0'));
+
+    uint32_t xrefs = static_cast<uint32_t>(disassembler_->xrefs().countTo(address));
+    size_t note = annotations_ ? annotations_->find(address) : AnnotationTable::npos;
+    row.note = xrefs != 0 ? QStringLiteral("; xrefs: %1").arg(xrefs) : QString();
+    if (note != AnnotationTable::npos)
+    {
+        if (!row.note.isEmpty())
+        {
+            row.note += QStringLiteral("  ");
+        }
+        row.note += QStringLiteral("; ") + annotations_->text(note);
+    }
+
+    ByteSpan bytes = disassembler_->bytes(address).sub(0, length);
+
+    static const char digits[] = "0123456789abcdef";
+    char hex[BYTE_COLUMNS * 3];
+    int byteCount = std::min<int>(static_cast<int>(bytes.size()), BYTE_COLUMNS);
+    for (int b = 0; b < byteCount; ++b)
+    {
+        hex[b * 3] = digits[bytes.u8(b) >> 4];
+        hex[b * 3 + 1] = digits[bytes.u8(b) & 0xF];
+        hex[b * 3 + 2] = ' ';
+    }
+    row.bytes = QString::fromLatin1(hex, byteCount * 3);
+
+    row.runs.clear();
+    if (bytes.empty() || !arch_->instructionText(address, bytes.data(), bytes.size(), tokens_))
+    {
+        row.runs.push_back(Run{QStringLiteral("(bad)"), 0, Architecture::Token::TYPE_TEXT});
+        row.textLength = 5;
+        return;
+    }
+
+    // Tokens of one type that follow each other in the text become one run
+    int column = 0;
+    for (size_t t = 0; t < tokens_.size();)
+    {
+        const Architecture::Token &token = tokens_[t];
+        size_t runEnd = t + 1;
+        int runLength = token.length;
+        while (runEnd < tokens_.size() && tokens_[runEnd].type == token.type &&
+               tokens_[runEnd].offset == token.offset + runLength)
+        {
+            runLength += tokens_[runEnd++].length;
+        }
+
+        row.runs.push_back(Run{QString::fromLatin1(tokens_.text(token), runLength), column, token.type});
+        column += runLength;
+        t = runEnd;
+    }
+    row.textLength = column;
+}
+
+const QColor &DisassemblyView::tokenColor(Architecture::Token::Type type) const
+{
+    switch (type)
+    {
+    case Architecture::Token::TYPE_MNEMONIC:
+        return mnemonicColor_;
+    case Architecture::Token::TYPE_REGISTER:
+        return registerColor_;
+    case Architecture::Token::TYPE_CONSTANT:
+        return constantColor_;
+    case Architecture::Token::TYPE_ADDRESS:
+        return targetColor_;
+    default:
+        return textColor_;
+    }
+}
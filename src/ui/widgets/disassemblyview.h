@@ -0,0 +1,114 @@
+#ifndef DISASSEMBLYVIEW_H
+#define DISASSEMBLYVIEW_H
+
+#include "annotationtable.h"
+#include "arch/architecture.h"
+#include <QAbstractScrollArea>
+#include <QColor>
+#include <QString>
+#include <vector>
+
+class Disassembler;
+
+/* Shows the instructions of a Disassembler one per row. Nothing is kept
+ * per instruction: only the rows in the viewport plus a small prefetch
+ * margin are decoded and formatted, into a row cache that is reused while
+ * scrolling, so memory does not grow with the size of the program. Rows
+ * hold their finished strings, so repainting them only draws.
+ *
+ * The context menu defines and undefines code and functions, and the view
+ * rereads the disassembler after each edit. It also sets the comments
+ * shown at the end of each row. */
+class DisassemblyView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    DisassemblyView(QWidget *parent = 0);
+
+    /* Sets the disassembler to show. It must outlive the view or be
+     * replaced before it is destroyed */
+    void setDisassembler(Disassembler *disassembler);
+
+    // Sets the comments to show and edit. Null hides them
+    void setAnnotations(AnnotationTablePtr annotations);
+
+public slots:
+    // Rereads the instruction index after the disassembler changed
+    void refresh();
+
+    // Scrolls to the instruction at or after address
+    void goToAddress(uint64_t address);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void changeEvent(QEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+
+private:
+    // Adjacent tokens of one type, drawn with one call
+    struct Run
+    {
+        QString text;
+        // Characters from the start of the instruction text
+        int column;
+        Architecture::Token::Type type;
+    };
+
+    struct Row
+    {
+        QString address;
+        QString bytes;
+        // The instruction text, or "(bad)" if it cannot be decoded
+        std::vector<Run> runs;
+        // Width of the runs in characters
+        int textLength;
+        // The reference count and comment shown after the text, or empty
+        QString note;
+    };
+
+    // Rows decoded above and below the viewport
+    static const size_t PREFETCH_ROWS = 32;
+
+    // Instruction bytes shown before the text column
+    static const int BYTE_COLUMNS = 8;
+
+    void updateMetrics();
+    void updateScrollBars();
+    int visibleRows() const;
+
+    // Makes sure rows [first, first + count) are in the cache
+    void fillCache(size_t first, size_t count);
+    void decodeRow(size_t index, Row &row);
+
+    const QColor &tokenColor(Architecture::Token::Type type) const;
+
+    Disassembler *disassembler_;
+    AnnotationTablePtr annotations_;
+    ArchitecturePtr arch_;
+
+    // Scratch space for decoding rows
+    Architecture::TokenList tokens_;
+
+    // Index of the instruction in rows_[0]. Rows are only valid while
+    // cacheCount_ is nonzero
+    size_t cacheFirst_;
+    size_t cacheCount_;
+    std::vector<Row> rows_;
+
+    int lineHeight_;
+    int ascent_;
+    int charWidth_;
+    int addressDigits_;
+
+    QColor addressColor_;
+    QColor bytesColor_;
+    QColor textColor_;
+    QColor mnemonicColor_;
+    QColor registerColor_;
+    QColor constantColor_;
+    QColor targetColor_;
+};
+
+#endif // DISASSEMBLYVIEW_H
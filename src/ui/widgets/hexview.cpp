@@ -0,0 +1,275 @@
+#include "hexview.h"
+#include "log.h"
+
+#include <QFontDatabase>
+#include <QInputDialog>
+#include <QKeyEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <algorithm>
+#include <climits>
+
+// Characters between the offset and the bytes, and between the bytes and
+// the text column
+static const int COLUMN_GAP = 2;
+
+HexView::HexView(QWidget *parent)
+    : QAbstractScrollArea(parent), linesPerStep_(1),
+      cursor_(static_cast<uint64_t>(-1)), lineHeight_(1), ascent_(0),
+      charWidth_(1), offsetDigits_(8), offsetColor_(128, 128, 128),
+      cursorColor_(255, 220, 120)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    updateMetrics();
+}
+
+void HexView::setFile(CoffFilePtr cofffile)
+{
+    file_ = cofffile;
+    mapping_ = cofffile ? cofffile->mapping() : nullptr;
+    data_ = mapping_ ? ByteSpan(mapping_->data(), mapping_->size())
+                     : ByteSpan();
+    cursor_ = static_cast<uint64_t>(-1);
+    offsetDigits_ = data_.size() > 0xFFFFFFFFull ? 16 : 8;
+
+    updateScrollBars();
+    verticalScrollBar()->setValue(0);
+    viewport()->update();
+}
+
+void HexView::goToOffset(uint64_t offset)
+{
+    if (offset >= data_.size())
+    {
+        return;
+    }
+
+    cursor_ = offset;
+    uint64_t line = offset / BYTES_PER_LINE;
+    verticalScrollBar()->setValue(static_cast<int>(std::min<uint64_t>(
+        line / linesPerStep_, verticalScrollBar()->maximum())));
+    viewport()->update();
+}
+
+bool HexView::goToRva(uint32_t rva)
+{
+    uint32_t offset;
+    if (!file_ || !file_->rvaToOffset(rva, offset))
+    {
+        return false;
+    }
+
+    goToOffset(offset);
+    return true;
+}
+
+void HexView::goToPrompt()
+{
+    bool ok;
+    QString text = QInputDialog::getText(
+        this, tr("Go To"), tr("File offset, or RVA prefixed with r (hex):"),
+        QLineEdit::Normal, QString(), &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    text = text.trimmed();
+    bool rva = text.startsWith(QLatin1Char('r'), Qt::CaseInsensitive);
+    if (rva)
+    {
+        text = text.mid(1);
+    }
+
+    uint64_t value = text.toULongLong(&ok, 16);
+    if (!ok)
+    {
+        return;
+    }
+
+    if (rva)
+    {
+        if (value > 0xFFFFFFFFull || !goToRva(static_cast<uint32_t>(value)))
+        {
+            Log::warning(QString("RVA 0x%1 is not backed by file data")
+                             .arg(value, 0, 16));
+        }
+    }
+    else
+    {
+        goToOffset(value);
+    }
+}
+
+void HexView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+
+    if (data_.empty())
+    {
+        return;
+    }
+
+    painter.setFont(font());
+
+    static const char digits[] = "0123456789abcdef";
+    char line[16 + COLUMN_GAP + BYTES_PER_LINE * 3 + 1 + COLUMN_GAP +
+              BYTES_PER_LINE];
+
+    int x = charWidth_ - horizontalScrollBar()->value();
+    int bytesColumn = offsetDigits_ + COLUMN_GAP;
+    int textColumn = bytesColumn + BYTES_PER_LINE * 3 + 1 + COLUMN_GAP - 1;
+
+    uint64_t first = topLine();
+    uint64_t last = std::min<uint64_t>(first + visibleLines() + 1, lineCount());
+
+    for (uint64_t lineIndex = first; lineIndex < last; ++lineIndex)
+    {
+        uint64_t offset = lineIndex * BYTES_PER_LINE;
+        int count = static_cast<int>(
+            std::min<uint64_t>(BYTES_PER_LINE, data_.size() - offset));
+        int y = static_cast<int>(lineIndex - first) * lineHeight_;
+
+        if (cursor_ >= offset && cursor_ < offset + count)
+        {
+            int b = static_cast<int>(cursor_ - offset);
+            int column = bytesColumn + b * 3 + (b >= BYTES_PER_LINE / 2);
+            painter.fillRect(QRect(x + column * charWidth_, y, charWidth_ * 2,
+                                   lineHeight_),
+                             cursorColor_);
+            painter.fillRect(QRect(x + (textColumn + b) * charWidth_, y,
+                                   charWidth_, lineHeight_),
+                             cursorColor_);
+        }
+
+        // The whole line is built in one buffer, padded so the text column
+        // lines up on a short last line
+        int length = 0;
+        for (int d = offsetDigits_ - 1; d >= 0; --d)
+        {
+            line[length++] = digits[(offset >> (d * 4)) & 0xF];
+        }
+        while (length < bytesColumn)
+        {
+            line[length++] = ' ';
+        }
+
+        for (int b = 0; b < BYTES_PER_LINE; ++b)
+        {
+            if (b == BYTES_PER_LINE / 2)
+            {
+                line[length++] = ' ';
+            }
+            if (b < count)
+            {
+                uint8_t byte = data_.u8(offset + b);
+                line[length++] = digits[byte >> 4];
+                line[length++] = digits[byte & 0xF];
+            }
+            else
+            {
+                line[length++] = ' ';
+                line[length++] = ' ';
+            }
+            line[length++] = ' ';
+        }
+        while (length < textColumn)
+        {
+            line[length++] = ' ';
+        }
+
+        for (int b = 0; b < count; ++b)
+        {
+            char c = data_.data()[offset + b];
+            line[length++] = (c >= 0x20 && c < 0x7F) ? c : '.';
+        }
+
+        painter.setPen(offsetColor_);
+        painter.drawText(x, y + ascent_,
+                         QString::fromLatin1(line, offsetDigits_));
+        painter.setPen(textColor_);
+        painter.drawText(x + bytesColumn * charWidth_, y + ascent_,
+                         QString::fromLatin1(line + bytesColumn,
+                                             length - bytesColumn));
+    }
+}
+
+void HexView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void HexView::scrollContentsBy(int dx, int dy)
+{
+    viewport()->update();
+}
+
+void HexView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange ||
+        event->type() == QEvent::PaletteChange)
+    {
+        updateMetrics();
+        updateScrollBars();
+        viewport()->update();
+    }
+}
+
+void HexView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_G &&
+        (event->modifiers() & Qt::ControlModifier))
+    {
+        goToPrompt();
+        return;
+    }
+
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void HexView::updateMetrics()
+{
+    QFontMetrics metrics(font());
+    lineHeight_ = std::max(metrics.height(), 1);
+    ascent_ = metrics.ascent();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    charWidth_ = std::max(metrics.horizontalAdvance(QLatin1Char('0')), 1);
+#else
+    charWidth_ = std::max(metrics.width(QLatin1Char('0')), 1);
+#endif
+    textColor_ = palette().text().color();
+}
+
+void HexView::updateScrollBars()
+{
+    int rows = visibleLines();
+    uint64_t lines = lineCount();
+    uint64_t maximum = lines > static_cast<uint64_t>(rows) ? lines - rows : 0;
+
+    linesPerStep_ = maximum / INT_MAX + 1;
+    verticalScrollBar()->setRange(0, static_cast<int>(maximum / linesPerStep_));
+    verticalScrollBar()->setPageStep(
+        std::max(static_cast<int>(rows / linesPerStep_), 1));
+    verticalScrollBar()->setSingleStep(1);
+
+    int width = (offsetDigits_ + COLUMN_GAP + BYTES_PER_LINE * 3 + COLUMN_GAP +
+                 BYTES_PER_LINE + 2) *
+                charWidth_;
+    horizontalScrollBar()->setRange(0, std::max(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(charWidth_);
+}
+
+int HexView::visibleLines() const
+{
+    return std::max(viewport()->height() / lineHeight_, 1);
+}
+
+uint64_t HexView::topLine() const
+{
+    return static_cast<uint64_t>(verticalScrollBar()->value()) * linesPerStep_;
+}
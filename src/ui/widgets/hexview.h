@@ -0,0 +1,77 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include "pe/cofffile.h"
+#include <QAbstractScrollArea>
+#include <QColor>
+
+/* Shows the bytes of a mapped file 16 to a line. Lines are formatted
+ * straight from the mapping while painting and only the visible ones are
+ * touched, so the cost of a frame and of a jump does not depend on the
+ * size of the file. Files with more lines than a scroll bar can count
+ * scroll several lines per step. */
+class HexView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    HexView(QWidget *parent = 0);
+
+    /* Shows the file behind cofffile. Files that were not mapped are not
+     * shown */
+    void setFile(CoffFilePtr cofffile);
+
+public slots:
+    // Scrolls to and marks the byte at a file offset
+    void goToOffset(uint64_t offset);
+
+    /* Scrolls to the byte an RVA is loaded from. Returns false if the RVA
+     * is not backed by file data */
+    bool goToRva(uint32_t rva);
+
+    // Asks for an offset or RVA and goes to it
+    void goToPrompt();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void changeEvent(QEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    static const int BYTES_PER_LINE = 16;
+
+    void updateMetrics();
+    void updateScrollBars();
+    int visibleLines() const;
+
+    inline uint64_t lineCount() const
+    {
+        return (data_.size() + BYTES_PER_LINE - 1) / BYTES_PER_LINE;
+    }
+
+    // Returns the first line in the viewport
+    uint64_t topLine() const;
+
+    CoffFilePtr file_;
+    MappedFilePtr mapping_;
+    ByteSpan data_;
+
+    // Lines per scroll bar step. Only more than one for files with more
+    // lines than fit in an int
+    uint64_t linesPerStep_;
+
+    // The marked byte, or -1
+    uint64_t cursor_;
+
+    int lineHeight_;
+    int ascent_;
+    int charWidth_;
+    int offsetDigits_;
+
+    QColor offsetColor_;
+    QColor textColor_;
+    QColor cursorColor_;
+};
+
+#endif // HEXVIEW_H
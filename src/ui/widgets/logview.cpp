@@ -3,6 +3,9 @@
 #include <QIdentityProxyModel>
 
 #include <QApplication>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextDocument>
 
 class LogProxyModel : public QIdentityProxyModel
 {
@@ -33,12 +36,36 @@ public:
     }
 };
 
+// Returns a row's text with its line breaks kept inside one block, so that
+// row i is always block i
+static QString rowText(QString text)
+{
+    text.replace(QLatin1String("\r\n"), QString(QChar::LineSeparator));
+    for (QChar &c : text)
+    {
+        if (c == QLatin1Char('\n') || c == QLatin1Char('\r') ||
+            c == QChar::ParagraphSeparator)
+        {
+            c = QChar::LineSeparator;
+        }
+    }
+    return text;
+}
+
 LogView::LogView(QWidget *parent)
     : QPlainTextEdit(parent), model_(new LogProxyModel(this))
 {
     connect(model_, &QAbstractItemModel::rowsInserted, this,
             &LogView::rowsInserted);
+    connect(model_, &QAbstractItemModel::rowsRemoved, this,
+            &LogView::rowsRemoved);
     connect(model_, &QAbstractItemModel::modelReset, this, &LogView::reset);
+
+    baseFormat_.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    lastFormat_ = baseFormat_;
+
+    // The undo stack would keep a copy of every removed row
+    setUndoRedoEnabled(false);
 }
 
 void LogView::setModel(QAbstractItemModel *model)
@@ -48,39 +75,113 @@ void LogView::setModel(QAbstractItemModel *model)
     reset();
 }
 
+const QTextCharFormat &LogView::format(const QModelIndex &index)
+{
+    QVariant foreground = model_->data(index, Qt::TextColorRole);
+    QVariant background = model_->data(index, Qt::BackgroundColorRole);
+    if (foreground == lastForeground_ && background == lastBackground_)
+    {
+        return lastFormat_;
+    }
+
+    lastFormat_ = baseFormat_;
+    if (foreground.isValid())
+    {
+        lastFormat_.setForeground(foreground.value<QColor>());
+    }
+    if (background.isValid())
+    {
+        lastFormat_.setBackground(background.value<QColor>());
+    }
+    lastForeground_ = foreground;
+    lastBackground_ = background;
+    return lastFormat_;
+}
+
 void LogView::rowsInserted(const QModelIndex &parent, int first, int last)
 {
-    for (int i = first; i <= last; ++i)
+    if (first > last)
     {
-        auto index = model_->index(i, 0, parent);
+        return;
+    }
 
-        QTextCharFormat format;
+    QScrollBar *scrollBar = verticalScrollBar();
+    bool atBottom = scrollBar->value() == scrollBar->maximum();
 
-        auto foregroundColor = model_->data(index, Qt::TextColorRole);
-        if (foregroundColor.isValid())
+    // Rows are almost always appended; otherwise insert before the block
+    // of the row that follows them
+    bool atEnd = last + 1 >= model_->rowCount(parent);
+    QTextCursor cursor(document());
+    if (atEnd)
+    {
+        cursor.movePosition(QTextCursor::End);
+    }
+    else
+    {
+        cursor = QTextCursor(document()->findBlockByNumber(first));
+    }
+
+    // Consecutive rows with the same format are inserted with one call;
+    // the newlines between rows become block separators
+    cursor.beginEditBlock();
+    QString text;
+    QTextCharFormat runFormat;
+    for (int i = first; i <= last; ++i)
+    {
+        QModelIndex index = model_->index(i, 0, parent);
+        const QTextCharFormat &rowFormat = format(index);
+        if (i != first && rowFormat != runFormat)
         {
-            format.setForeground(foregroundColor.value<QColor>());
+            cursor.insertText(text, runFormat);
+            text.clear();
         }
+        runFormat = rowFormat;
 
-        auto backgroundColor = model_->data(index, Qt::BackgroundColorRole);
-        if (backgroundColor.isValid())
+        if (i != 0 && atEnd)
+        {
+            text += QLatin1Char('\n');
+        }
+        text += rowText(model_->data(index, Qt::DisplayRole).toString());
+        if (!atEnd)
         {
-            format.setBackground(backgroundColor.value<QColor>());
+            text += QLatin1Char('\n');
         }
+    }
+    cursor.insertText(text, runFormat);
+    cursor.endEditBlock();
 
-        format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    if (atBottom)
+    {
+        scrollBar->setValue(scrollBar->maximum());
+    }
+}
 
-        QString text = model_->data(index, Qt::DisplayRole).toString();
+void LogView::rowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    QTextDocument *document = this->document();
+    if (first >= document->blockCount())
+    {
+        return;
+    }
 
-        QTextCursor cursor = textCursor();
-        cursor.movePosition(QTextCursor::End);
-        if (i != 0)
+    // Remove the blocks with the separator that follows them, or the one
+    // that precedes them at the end of the document
+    QTextCursor cursor(document->findBlockByNumber(first));
+    QTextBlock next = document->findBlockByNumber(last + 1);
+    if (next.isValid())
+    {
+        cursor.setPosition(next.position(), QTextCursor::KeepAnchor);
+    }
+    else
+    {
+        if (first != 0)
         {
-            cursor.insertBlock();
+            cursor.movePosition(QTextCursor::PreviousBlock);
+            cursor.movePosition(QTextCursor::EndOfBlock);
         }
-
-        cursor.insertText(text, format);
+        cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
     }
+    cursor.removeSelectedText();
 }
 
 void LogView::reset()
@@ -3,9 +3,13 @@
 
 #include <QAbstractItemModel>
 #include <QPlainTextEdit>
+#include <QTextCharFormat>
 
 class LogProxyModel;
 
+/* Shows the rows of a log model as lines of text. Row i is block i of the
+ * document, so appended rows are inserted at the end and removed rows are
+ * cut from the document without rendering the rest again. */
 class LogView : public QPlainTextEdit
 {
     Q_OBJECT
@@ -13,11 +17,23 @@ public:
     LogView(QWidget *parent = 0);
 
 private:
+    /* Returns the format of a row. Only builds a new one when the colors
+     * differ from the previous row's */
+    const QTextCharFormat &format(const QModelIndex &index);
+
     LogProxyModel *model_;
 
+    // The fixed font, looked up once
+    QTextCharFormat baseFormat_;
+
+    QVariant lastForeground_;
+    QVariant lastBackground_;
+    QTextCharFormat lastFormat_;
+
 public slots:
     void setModel(QAbstractItemModel *model);
     void rowsInserted(const QModelIndex &parent, int first, int last);
+    void rowsRemoved(const QModelIndex &parent, int first, int last);
     void reset();
 };
 
@@ -0,0 +1,107 @@
+#include "workstealingscheduler.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// The indices a worker has left. The owner pops from the front and
+// thieves pop from the back
+struct WorkerQueue
+{
+    std::mutex mutex;
+    size_t begin;
+    size_t end;
+
+    bool popFront(size_t &index)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (begin == end)
+        {
+            return false;
+        }
+        index = begin++;
+        return true;
+    }
+
+    bool popBack(size_t &index)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (begin == end)
+        {
+            return false;
+        }
+        index = --end;
+        return true;
+    }
+};
+}
+
+WorkStealingScheduler::WorkStealingScheduler(unsigned threadCount)
+    : threadCount_(threadCount)
+{
+    if (threadCount_ == 0)
+    {
+        threadCount_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+void WorkStealingScheduler::run(size_t count, const Task &task)
+{
+    unsigned workers =
+        static_cast<unsigned>(std::min<size_t>(threadCount_, count));
+    if (workers <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            task(0, i);
+        }
+        return;
+    }
+
+    std::vector<WorkerQueue> queues(workers);
+    for (unsigned i = 0; i < workers; ++i)
+    {
+        queues[i].begin = count * i / workers;
+        queues[i].end = count * (i + 1) / workers;
+    }
+
+    auto worker = [&](unsigned id) {
+        size_t index;
+        for (;;)
+        {
+            if (queues[id].popFront(index))
+            {
+                task(id, index);
+                continue;
+            }
+
+            // Steal from the other workers, starting with the next one.
+            // Shares only shrink, so one pass that finds nothing means all
+            // work has been taken
+            bool stolen = false;
+            for (unsigned i = 1; i < workers && !stolen; ++i)
+            {
+                stolen = queues[(id + i) % workers].popBack(index);
+            }
+            if (!stolen)
+            {
+                return;
+            }
+            task(id, index);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < workers; ++i)
+    {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
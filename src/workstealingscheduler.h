@@ -0,0 +1,32 @@
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H
+#include <cstddef>
+#include <functional>
+
+/* Runs indexed tasks on a set of worker threads. Each worker starts with a
+ * contiguous share of the indices and takes them from the front. A worker
+ * that runs out steals indices from the back of another worker's share,
+ * so uneven task costs do not leave threads idle. */
+class WorkStealingScheduler
+{
+public:
+    typedef std::function<void(unsigned worker, size_t index)> Task;
+
+    /* A thread count of zero uses one thread per core */
+    WorkStealingScheduler(unsigned threadCount = 0);
+
+    inline unsigned threadCount() const
+    {
+        return threadCount_;
+    }
+
+    /* Runs task for every index in [0, count) and blocks until all are
+     * done. worker is in [0, threadCount()) and identifies the thread, so
+     * tasks can use per-worker state without locking */
+    void run(size_t count, const Task &task);
+
+private:
+    unsigned threadCount_;
+};
+
+#endif // WORKSTEALINGSCHEDULER_H